@@ -0,0 +1,81 @@
+/*************************************************************************
+Title:    Control Point Aspect Tables
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     config-aspects.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _CONFIG_ASPECTS_H_
+#define _CONFIG_ASPECTS_H_
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "aspects.h"
+#include "config-signals.h"
+#include "config-inputs.h"
+
+// These, along with the route table in config-route-table.h, replace the
+//  hand-written branches that used to pick aspects in vitalLogic().  The two
+//  tables below are generated - "mrb-xo3-host tables" works them out from the
+//  original logic (host/vital-reference.h) and prints them, so change that
+//  and paste the output in rather than editing them by hand.  "mrb-xo3-host
+//  verify" then checks them over every route, occupancy, turnout and
+//  timelock combination.
+
+// Aspect shown beyond a cleared route, indexed by the occupancy code
+//  bit 0 - adjoining block, bit 1 - approach block, bit 2 - second approach block
+//  Nearest occupancy wins.
+#define CP_OCC_ADJOIN     0x01
+#define CP_OCC_APPROACH   0x02
+#define CP_OCC_APPROACH2  0x04
+
+static const uint8_t cpOccupancyAspect[8] PROGMEM =
+{
+	[0] = ASPECT_GREEN,
+	[CP_OCC_ADJOIN] = ASPECT_RED,
+	[CP_OCC_APPROACH] = ASPECT_YELLOW,
+	[CP_OCC_APPROACH | CP_OCC_ADJOIN] = ASPECT_RED,
+	[CP_OCC_APPROACH2] = ASPECT_FL_YELLOW,
+	[CP_OCC_APPROACH2 | CP_OCC_ADJOIN] = ASPECT_RED,
+	[CP_OCC_APPROACH2 | CP_OCC_APPROACH] = ASPECT_YELLOW,
+	[CP_OCC_APPROACH2 | CP_OCC_APPROACH | CP_OCC_ADJOIN] = ASPECT_RED,
+};
+
+// Heads showing restricting (flashing red) with the timelock unlocked,
+//  indexed by turnout positions - bit 2 east crossover, bit 1 west crossover,
+//  bit 0 M1-M3, each set when normal
+#define CP_UNLOCKED_E_XOVER_NORMAL  0x04
+#define CP_UNLOCKED_W_XOVER_NORMAL  0x02
+#define CP_UNLOCKED_M1_M3_NORMAL    0x01
+
+#define SIG_MASK(head)  ((uint16_t)1 << (head))
+
+static const uint16_t cpUnlockedRestricting[8] PROGMEM =
+{
+	[0] = SIG_MASK(SIG_MAIN2_E_LOWER) | SIG_MASK(SIG_MAIN2_W_LOWER),
+	[CP_UNLOCKED_M1_M3_NORMAL] = SIG_MASK(SIG_MAIN2_E_LOWER) | SIG_MASK(SIG_MAIN2_W_LOWER),
+	[CP_UNLOCKED_W_XOVER_NORMAL] = SIG_MASK(SIG_MAIN2_E_LOWER) | SIG_MASK(SIG_MAIN3_W_LOWER),
+	[CP_UNLOCKED_W_XOVER_NORMAL | CP_UNLOCKED_M1_M3_NORMAL] = SIG_MASK(SIG_MAIN2_E_LOWER) | SIG_MASK(SIG_MAIN1_W_LOWER),
+	[CP_UNLOCKED_E_XOVER_NORMAL] = SIG_MASK(SIG_MAIN1_E_LOWER) | SIG_MASK(SIG_MAIN2_W_LOWER),
+	[CP_UNLOCKED_E_XOVER_NORMAL | CP_UNLOCKED_M1_M3_NORMAL] = SIG_MASK(SIG_MAIN1_E_LOWER) | SIG_MASK(SIG_MAIN2_W_LOWER),
+	[CP_UNLOCKED_E_XOVER_NORMAL | CP_UNLOCKED_W_XOVER_NORMAL] = SIG_MASK(SIG_MAIN1_E_LOWER) | SIG_MASK(SIG_MAIN2_E_UPPER) | SIG_MASK(SIG_MAIN2_W_UPPER) | SIG_MASK(SIG_MAIN3_W_UPPER),
+	[CP_UNLOCKED_E_XOVER_NORMAL | CP_UNLOCKED_W_XOVER_NORMAL | CP_UNLOCKED_M1_M3_NORMAL] = SIG_MASK(SIG_MAIN1_E_UPPER) | SIG_MASK(SIG_MAIN2_E_UPPER) | SIG_MASK(SIG_MAIN1_W_UPPER) | SIG_MASK(SIG_MAIN2_W_UPPER),
+};
+
+typedef char CPSignalMaskWideEnough_t[(SIG_END <= 16) ? 1 : -1];
+
+#endif
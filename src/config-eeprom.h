@@ -29,6 +29,13 @@ LICENSE:
 #define EE_UNLOCK_TIME        0x09
 // Unlock time in decisecs
 
+#define EE_XIO_REFRESH_TIME   0x0A
+// Seconds between full XIO register refreshes, 0 or 0xFF for the default
+
+// Virtual input (MRBus bit/byte) configuration lives in 0x10-0x65
+#define EE_VINPUT_CONFIG_START  0x10
+#define EE_VINPUT_CONFIG_END    0x65
+
 #define EE_M1E_APRCH_ADDR       0x10
 #define EE_M1E_APRCH2_ADDR      0x11
 #define EE_M1E_ADJ_ADDR         0x12
@@ -98,4 +105,9 @@ LICENSE:
 #define EE_M1_OS_BITBYTE        0x64
 #define EE_M2_OS_BITBYTE        0x65
 
+// Input debounce widths, one byte per XIO port (A-E), XIO n at EE_XIO_DEBOUNCE_WIDTH + 8*n
+//  Changes have to hold for 2^width samples at 50Hz - 0 to 4, 0xFF for the default of 2
+#define EE_XIO_DEBOUNCE_WIDTH      0x70
+#define EE_XIO_DEBOUNCE_WIDTH_END  0xAF  // Room for all eight XIO addresses
+
 #endif
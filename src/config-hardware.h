@@ -24,49 +24,128 @@ LICENSE:
 
 #include "config-signals.h"
 #include "config-inputs.h"
+#include "config-xio.h"
 
+// Only controlpoint.c includes this.  The tables built from the pin lists are
+//  static and live in flash - read them with memcpy_P()/pgm_read_byte().
+
+// The XIO pin tables are X-macro lists, so the same entries expand into the
+//  runtime tables below and into compile-time checks that no two outputs share
+//  a pin and no output sits on a pin that's configured as an input.  Each
+//  entry gets the expanding macro's ctx argument passed through first.
+
+/* Turnout control outputs
+ *    Turnout ID        XIO #
+ *    |                 |  Control Port
+ *    |                 |  |           Control Pin
+ *    |                 |  |           |  Normal when control is low
+ *    v                 v  v           v  v                                  */
+#define CP_TURNOUT_PINS(X, ctx) \
+	X(ctx, TURNOUT_E_XOVER, 1, XIO_PORT_A, 0, false) \
+	X(ctx, TURNOUT_W_XOVER, 1, XIO_PORT_A, 1, false) \
+	X(ctx, TURNOUT_M1_M3,   1, XIO_PORT_A, 2, false)
+
+/* Signal head outputs
+ *    Signal Head         XIO #
+ *    |                   |  Red Port/Pin  Yellow Port/Pin Green Port/Pin
+ *    |                   |  |             |               |               Common anode (low turns a lamp on)
+ *    v                   v  v             v               v               v */
+#define CP_SIGNAL_PINS(X, ctx) \
+	X(ctx, SIG_MAIN1_E_UPPER, 0, XIO_PORT_A, 0, XIO_PORT_A, 1, XIO_PORT_A, 2, false) \
+	X(ctx, SIG_MAIN1_E_LOWER, 0, XIO_PORT_A, 3, XIO_PORT_A, 4, XIO_PORT_A, 5, false) \
+	X(ctx, SIG_MAIN2_E_UPPER, 0, XIO_PORT_A, 6, XIO_PORT_A, 7, XIO_PORT_B, 0, false) \
+	X(ctx, SIG_MAIN2_E_LOWER, 0, XIO_PORT_B, 1, XIO_PORT_B, 2, XIO_PORT_B, 3, false) \
+	X(ctx, SIG_MAIN1_W_UPPER, 0, XIO_PORT_B, 4, XIO_PORT_B, 5, XIO_PORT_B, 6, false) \
+	X(ctx, SIG_MAIN1_W_LOWER, 0, XIO_PORT_B, 7, XIO_PORT_C, 0, XIO_PORT_C, 1, false) \
+	X(ctx, SIG_MAIN2_W_UPPER, 0, XIO_PORT_C, 2, XIO_PORT_C, 3, XIO_PORT_C, 4, false) \
+	X(ctx, SIG_MAIN2_W_LOWER, 0, XIO_PORT_C, 5, XIO_PORT_C, 6, XIO_PORT_C, 7, false) \
+	X(ctx, SIG_MAIN3_W_UPPER, 0, XIO_PORT_D, 0, XIO_PORT_D, 1, XIO_PORT_D, 2, false) \
+	X(ctx, SIG_MAIN3_W_LOWER, 0, XIO_PORT_D, 3, XIO_PORT_D, 4, XIO_PORT_D, 5, false)
+
+/* Other outputs
+ *    Output ID           XIO #
+ *    |                   |  Port        Pin
+ *    |                   |  |           |  On when low
+ *    v                   v  v           v  v                                 */
+#define CP_MISC_OUTPUT_PINS(X, ctx) \
+	X(ctx, MISC_TIMELOCK_LED, 0, XIO_PORT_D, 6, false)
+
+/* XIO inputs
+ *    Virtual Input ID (from CPInputNames_t)
+ *    |                   XIO #
+ *    |                   |  XIO Port (A-E)
+ *    |                   |  |           XIO Port Pin
+ *    |                   |  |           |  Debounce going high (assert)
+ *    |                   |  |           |  |              Debounce going low (release)
+ *    v                   v  v           v  v              v
+ *
+ * An occupancy input would typically be DEBOUNCE_40MS, DEBOUNCE_320MS
+ */
+#define CP_XIO_INPUT_PINS(X, ctx) \
+	X(ctx, E_XOVER_ACTUAL_POS, 1, XIO_PORT_A, 6, DEBOUNCE_PORT, DEBOUNCE_PORT) \
+	X(ctx, W_XOVER_ACTUAL_POS, 1, XIO_PORT_A, 7, DEBOUNCE_PORT, DEBOUNCE_PORT) \
+	X(ctx, M1_M3_ACTUAL_POS,   1, XIO_PORT_B, 0, DEBOUNCE_PORT, DEBOUNCE_PORT) \
+	X(ctx, E_XOVER_MANUAL_POS, 1, XIO_PORT_A, 3, DEBOUNCE_PORT, DEBOUNCE_PORT) \
+	X(ctx, W_XOVER_MANUAL_POS, 1, XIO_PORT_A, 4, DEBOUNCE_PORT, DEBOUNCE_PORT) \
+	X(ctx, M1_M3_MANUAL_POS,   1, XIO_PORT_A, 5, DEBOUNCE_PORT, DEBOUNCE_PORT) \
+	X(ctx, TIMELOCK_SW_POS,    0, XIO_PORT_D, 7, DEBOUNCE_PORT, DEBOUNCE_PORT)
+
+
+// Turnouts, indexed by turnout ID
 typedef struct
 {
-	const CPTurnoutNames_t turnoutID;
-	const unsigned int xioNum : 3;
-	const unsigned int controlByte : 3;
-	const unsigned int controlBit : 3;
-	bool isNormalLow;  // Means the turnout is normal/main when control is low
-} TurnoutPinDefinition;
-
-const TurnoutPinDefinition const cpTurnoutPinDefs[TURNOUT_END] = 
+	uint8_t xioNum;
+	uint8_t port;
+	uint8_t mask;
+	uint8_t normalLevel;  // Control pin level for normal - either 0 or mask
+} CPTurnoutOutput_t;
+
+#define CP_TURNOUT_OUTPUT_DEF(ctx, id, xio, port, bit, isNormalLow) \
+	[id] = { xio, port, 1<<(bit), (isNormalLow) ? 0 : 1<<(bit) },
+
+static const CPTurnoutOutput_t cpTurnoutOutputs[TURNOUT_END] PROGMEM =
 {
-	{TURNOUT_E_XOVER, 1, XIO_PORT_A, 0, false},
-	{TURNOUT_W_XOVER, 1, XIO_PORT_A, 1, false},
-	{TURNOUT_M1_M3,   1, XIO_PORT_A, 2, false}
+	CP_TURNOUT_PINS(CP_TURNOUT_OUTPUT_DEF, 0)
 };
 
+
+// Other outputs, indexed by output ID
 typedef struct
 {
-	const CPSignalHeadNames_t signalHead;
-	const unsigned int xioNum : 3;
-	const unsigned int redByte : 3;
-	const unsigned int redBit : 3;
-	const unsigned int yellowByte : 3;
-	const unsigned int yellowBit : 3;
-	const unsigned int greenByte : 3;
-	const unsigned int greenBit : 3;
-	bool isCommonAnode;  // Common anode means output low to turn a signal on
-} SignalPinDefinition;
-
-const SignalPinDefinition const cpSignalPinDefs[SIG_END] = 
+	uint8_t xioNum;
+	uint8_t port;
+	uint8_t mask;
+	uint8_t onLevel;  // Pin level for on - either 0 or mask
+} CPMiscOutput_t;
+
+#define CP_MISC_OUTPUT_DEF(ctx, id, xio, port, bit, isOnLow) \
+	[id] = { xio, port, 1<<(bit), (isOnLow) ? 0 : 1<<(bit) },
+
+static const CPMiscOutput_t cpMiscOutputs[MISC_OUTPUT_END] PROGMEM =
+{
+	CP_MISC_OUTPUT_PINS(CP_MISC_OUTPUT_DEF, 0)
+};
+
+// Signal heads, indexed by head - the port and mask of each lamp
+#define CP_LAMP_RED       0
+#define CP_LAMP_YELLOW    1
+#define CP_LAMP_GREEN     2
+#define CP_LAMPS          3
+
+typedef struct
 {
-	{SIG_MAIN1_E_UPPER, 0, XIO_PORT_A, 0, XIO_PORT_A, 1, XIO_PORT_A, 2, false},
-	{SIG_MAIN1_E_LOWER, 0, XIO_PORT_A, 3, XIO_PORT_A, 4, XIO_PORT_A, 5, false},
-	{SIG_MAIN2_E_UPPER, 0, XIO_PORT_A, 6, XIO_PORT_A, 7, XIO_PORT_B, 0, false},
-	{SIG_MAIN2_E_LOWER, 0, XIO_PORT_B, 1, XIO_PORT_B, 2, XIO_PORT_B, 3, false},
-	{SIG_MAIN1_W_UPPER, 0, XIO_PORT_B, 4, XIO_PORT_B, 5, XIO_PORT_B, 6, false},
-	{SIG_MAIN1_W_LOWER, 0, XIO_PORT_B, 7, XIO_PORT_C, 0, XIO_PORT_C, 1, false},
-	{SIG_MAIN2_W_UPPER, 0, XIO_PORT_C, 2, XIO_PORT_C, 3, XIO_PORT_C, 4, false},
-	{SIG_MAIN2_W_LOWER, 0, XIO_PORT_C, 5, XIO_PORT_C, 6, XIO_PORT_C, 7, false},
-	{SIG_MAIN3_W_UPPER, 0, XIO_PORT_D, 0, XIO_PORT_D, 1, XIO_PORT_D, 2, false},
-	{SIG_MAIN3_W_LOWER, 0, XIO_PORT_D, 3, XIO_PORT_D, 4, XIO_PORT_D, 5, false}
+	uint8_t xioNum;
+	uint8_t port[CP_LAMPS];
+	uint8_t mask[CP_LAMPS];
+	uint8_t offLevel;  // 0xFF for common anode, 0x00 otherwise
+} CPSignalOutput_t;
+
+#define CP_SIGNAL_OUTPUT_DEF(ctx, id, xio, redPort, redBit, yellowPort, yellowBit, greenPort, greenBit, isCommonAnode) \
+	[id] = { xio, { redPort, yellowPort, greenPort }, { 1<<(redBit), 1<<(yellowBit), 1<<(greenBit) }, (isCommonAnode) ? 0xFF : 0x00 },
 
+static const CPSignalOutput_t cpSignalOutputs[SIG_END] PROGMEM =
+{
+	CP_SIGNAL_PINS(CP_SIGNAL_OUTPUT_DEF, 0)
 };
 
 const uint8_t vInputConfigArray[] PROGMEM = 
@@ -109,23 +188,103 @@ const uint8_t vInputConfigArray[] PROGMEM =
 	VOCC_M2_OS,          EE_M2_OS_ADDR,          EE_M2_OS_PKT,         EE_M2_OS_BITBYTE
 };
 
-const uint8_t xioInputConfigArray[] PROGMEM = 
+// XIO inputs as a gather list for CPXIOInputFilter()
+typedef struct
 {
-/* These go in 4-byte increments - vinput ID, srcAddr, pktType, bitbyte
- *  Virtual Input ID (from CPInputNames_t)
- *  |                    XIO #
- *  |                    |    XIO Port (A-E)
- *  |                    |    |            XIO Port Pin
- *  |                    |    |            |
- *  v                    v    v            v
-*/
-	E_XOVER_ACTUAL_POS,  1,   XIO_PORT_A,  6,
-	W_XOVER_ACTUAL_POS,  1,   XIO_PORT_A,  7,
-	M1_M3_ACTUAL_POS,    1,   XIO_PORT_B,  0,
-	E_XOVER_MANUAL_POS,  1,   XIO_PORT_A,  3,
-	W_XOVER_MANUAL_POS,  1,   XIO_PORT_A,  4,
-	M1_M3_MANUAL_POS,    1,   XIO_PORT_A,  5,
-	TIMELOCK_SW_POS,     0,   XIO_PORT_D,  7
+	uint8_t xioNum;
+	uint8_t port;
+	uint8_t mask;
+	uint8_t inputID;
+} CPXIOInputGather_t;
+
+#define CP_XIO_INPUT_GATHER_DEF(ctx, id, xio, port, bit, assertWidth, releaseWidth) \
+	{ xio, port, 1<<(bit), id },
+
+static const CPXIOInputGather_t cpXioInputGather[] PROGMEM =
+{
+	CP_XIO_INPUT_PINS(CP_XIO_INPUT_GATHER_DEF, 0)
 };
 
+
+// Compile-time pin checks.  Every pin is one bit of a 40 bit map of its XIO,
+//  port A in the low byte.  If no two outputs share a pin, adding up all the
+//  output bits gives the same thing as OR'ing them together.
+#define CP_PIN_BIT(n, xio, port, bit)  (((xio) == (n)) ? (1ULL << (8*(port) + (bit))) : 0ULL)
+
+#define CP_TURNOUT_PIN_SUM(n, id, xio, port, bit, isNormalLow)  + CP_PIN_BIT(n, xio, port, bit)
+#define CP_TURNOUT_PIN_OR(n, id, xio, port, bit, isNormalLow)   | CP_PIN_BIT(n, xio, port, bit)
+#define CP_SIGNAL_PIN_SUM(n, id, xio, rp, rb, yp, yb, gp, gb, ca) \
+	+ CP_PIN_BIT(n, xio, rp, rb) + CP_PIN_BIT(n, xio, yp, yb) + CP_PIN_BIT(n, xio, gp, gb)
+#define CP_SIGNAL_PIN_OR(n, id, xio, rp, rb, yp, yb, gp, gb, ca) \
+	| CP_PIN_BIT(n, xio, rp, rb) | CP_PIN_BIT(n, xio, yp, yb) | CP_PIN_BIT(n, xio, gp, gb)
+#define CP_MISC_PIN_SUM(n, id, xio, port, bit, isOnLow)  + CP_PIN_BIT(n, xio, port, bit)
+#define CP_MISC_PIN_OR(n, id, xio, port, bit, isOnLow)   | CP_PIN_BIT(n, xio, port, bit)
+#define CP_INPUT_PIN_OR(n, id, xio, port, bit, assertWidth, releaseWidth)  | CP_PIN_BIT(n, xio, port, bit)
+
+#define CP_OUTPUT_PINS_SUM(n)  (0ULL CP_TURNOUT_PINS(CP_TURNOUT_PIN_SUM, n) CP_SIGNAL_PINS(CP_SIGNAL_PIN_SUM, n) \
+	CP_MISC_OUTPUT_PINS(CP_MISC_PIN_SUM, n))
+#define CP_OUTPUT_PINS(n)      (0ULL CP_TURNOUT_PINS(CP_TURNOUT_PIN_OR, n) CP_SIGNAL_PINS(CP_SIGNAL_PIN_OR, n) \
+	CP_MISC_OUTPUT_PINS(CP_MISC_PIN_OR, n))
+#define CP_INPUT_PINS(n)       (0ULL CP_XIO_INPUT_PINS(CP_INPUT_PIN_OR, n))
+
+#define CP_XIO_PIN_CHECK(n) \
+	typedef char CPXio##n##OutputsOverlap_t[(CP_OUTPUT_PINS_SUM(n) == CP_OUTPUT_PINS(n)) ? 1 : -1]; \
+	typedef char CPXio##n##OutputOnInput_t[(0 == (CP_OUTPUT_PINS(n) & CP_INPUT_PINS(n))) ? 1 : -1];
+
+CP_XIO_PIN_CHECK(0)
+CP_XIO_PIN_CHECK(1)
+CP_XIO_PIN_CHECK(2)
+CP_XIO_PIN_CHECK(3)
+CP_XIO_PIN_CHECK(4)
+CP_XIO_PIN_CHECK(5)
+CP_XIO_PIN_CHECK(6)
+CP_XIO_PIN_CHECK(7)
+
+// ...and everything has to be on an XIO that exists, on a pin that exists
+#define CP_PIN_BAD(xio, port, bit)  + ((xio) >= CP_XIO_COUNT || (port) > XIO_PORT_E || (bit) > 7)
+#define CP_TURNOUT_PIN_BAD(ctx, id, xio, port, bit, isNormalLow)  CP_PIN_BAD(xio, port, bit)
+#define CP_SIGNAL_PIN_BAD(ctx, id, xio, rp, rb, yp, yb, gp, gb, ca) \
+	CP_PIN_BAD(xio, rp, rb) CP_PIN_BAD(xio, yp, yb) CP_PIN_BAD(xio, gp, gb)
+#define CP_MISC_PIN_BAD(ctx, id, xio, port, bit, isOnLow)  CP_PIN_BAD(xio, port, bit)
+#define CP_INPUT_PIN_BAD(ctx, id, xio, port, bit, assertWidth, releaseWidth)  CP_PIN_BAD(xio, port, bit)
+
+typedef char CPXioPinsExist_t[(0 CP_TURNOUT_PINS(CP_TURNOUT_PIN_BAD, 0) CP_SIGNAL_PINS(CP_SIGNAL_PIN_BAD, 0)
+	CP_MISC_OUTPUT_PINS(CP_MISC_PIN_BAD, 0) CP_XIO_INPUT_PINS(CP_INPUT_PIN_BAD, 0)) ? -1 : 1];
+
+// Per-input debounce widths, as an XIODebouncePinWidths for each XIO.  Inputs
+//  left at DEBOUNCE_PORT don't show up in it at all.  For the enables the ctx
+//  carries the XIO number in the high nibble and the counter bit in the low one.
+#define CP_INPUT_OWN_WIDTH(n, xio, port, bit, width) \
+	(((width) != DEBOUNCE_PORT) ? CP_PIN_BIT(n, xio, port, bit) : 0ULL)
+#define CP_INPUT_WIDTH_USES(c, xio, port, bit, width) \
+	(((width) != DEBOUNCE_PORT && (width) > ((c) & 0x0F)) ? CP_PIN_BIT((c) >> 4, xio, port, bit) : 0ULL)
+
+#define CP_INPUT_ASSERT_PIN_OR(n, id, xio, port, bit, assertWidth, releaseWidth)   | CP_INPUT_OWN_WIDTH(n, xio, port, bit, assertWidth)
+#define CP_INPUT_RELEASE_PIN_OR(n, id, xio, port, bit, assertWidth, releaseWidth)  | CP_INPUT_OWN_WIDTH(n, xio, port, bit, releaseWidth)
+#define CP_INPUT_ASSERT_USES_OR(c, id, xio, port, bit, assertWidth, releaseWidth)  | CP_INPUT_WIDTH_USES(c, xio, port, bit, assertWidth)
+#define CP_INPUT_RELEASE_USES_OR(c, id, xio, port, bit, assertWidth, releaseWidth) | CP_INPUT_WIDTH_USES(c, xio, port, bit, releaseWidth)
+
+#define CP_INPUT_ASSERT_PINS(n)          (0ULL CP_XIO_INPUT_PINS(CP_INPUT_ASSERT_PIN_OR, n))
+#define CP_INPUT_RELEASE_PINS(n)         (0ULL CP_XIO_INPUT_PINS(CP_INPUT_RELEASE_PIN_OR, n))
+#define CP_INPUT_ASSERT_ENABLE(n, k)     (0ULL CP_XIO_INPUT_PINS(CP_INPUT_ASSERT_USES_OR, ((n) << 4) | (k)))
+#define CP_INPUT_RELEASE_ENABLE(n, k)    (0ULL CP_XIO_INPUT_PINS(CP_INPUT_RELEASE_USES_OR, ((n) << 4) | (k)))
+
+#define CP_INPUT_ENABLES(enable, n, type, shift) \
+	{ (type)(enable(n, 0) >> (shift)), (type)(enable(n, 1) >> (shift)), (type)(enable(n, 2) >> (shift)), (type)(enable(n, 3) >> (shift)) }
+
+#define CP_XIO_PIN_WIDTHS(n) { \
+	(uint32_t)CP_INPUT_ASSERT_PINS(n), (uint32_t)CP_INPUT_RELEASE_PINS(n), \
+	CP_INPUT_ENABLES(CP_INPUT_ASSERT_ENABLE, n, uint32_t, 0), CP_INPUT_ENABLES(CP_INPUT_RELEASE_ENABLE, n, uint32_t, 0), \
+	(uint8_t)(CP_INPUT_ASSERT_PINS(n) >> 32), (uint8_t)(CP_INPUT_RELEASE_PINS(n) >> 32), \
+	CP_INPUT_ENABLES(CP_INPUT_ASSERT_ENABLE, n, uint8_t, 32), CP_INPUT_ENABLES(CP_INPUT_RELEASE_ENABLE, n, uint8_t, 32) }
+
+// CP_INPUT_ENABLES() spells out one entry per counter bit, and every width
+//  has to fit the counter
+#define CP_INPUT_WIDTH_BAD(ctx, id, xio, port, bit, assertWidth, releaseWidth) \
+	+ (((assertWidth) != DEBOUNCE_PORT && (assertWidth) > XIO_DEBOUNCE_MAX_WIDTH) \
+	|| ((releaseWidth) != DEBOUNCE_PORT && (releaseWidth) > XIO_DEBOUNCE_MAX_WIDTH))
+
+typedef char CPDebounceEnables_t[(4 == XIO_DEBOUNCE_MAX_WIDTH) ? 1 : -1];
+typedef char CPInputWidthsFit_t[(0 CP_XIO_INPUT_PINS(CP_INPUT_WIDTH_BAD, 0)) ? -1 : 1];
+
 #endif
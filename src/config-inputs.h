@@ -67,6 +67,15 @@ typedef enum
 } CPInputNames_t;
 
 #define vInputConfigRecSize     4
-#define xioInputConfigRecSize   4
+
+// Debounce widths for CP_XIO_INPUT_PINS - a change has to hold for 2^width
+//  samples at 50Hz before it's accepted.  Occupancy wants to assert fast and
+//  release slow, so a train shows up right away but flicker can't clear it.
+#define DEBOUNCE_20MS     0
+#define DEBOUNCE_40MS     1
+#define DEBOUNCE_80MS     2
+#define DEBOUNCE_160MS    3
+#define DEBOUNCE_320MS    4
+#define DEBOUNCE_PORT     0xFF  // Use the width set for the whole XIO port
 
 #endif
@@ -0,0 +1,118 @@
+/*************************************************************************
+Title:    Control Point Route Table
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     config-route-table.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _CONFIG_ROUTE_TABLE_H_
+#define _CONFIG_ROUTE_TABLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+#include "config-signals.h"
+#include "config-turnouts.h"
+#include "config-inputs.h"
+#include "config-route.h"
+
+// Everything the firmware knows about this control point's track plan.
+//  cpCodeRoute() takes the first route from an entrance that the requested
+//  turnout positions line, cpClearRoute() drops every route from an
+//  entrance, vitalLogic() drops routes when their OS track is occupied and
+//  picks aspects for the routes that are set.
+
+#define TURNOUT_MASK(turnout)  ((uint8_t)1 << (turnout))
+
+// Route table shorthand.  Whether a turnout has to be normal or reversed is
+//  down to which column of the table it's in.
+#define CP_ROUTE_OS_M1     INPUT_MASK(VOCC_M1_OS)
+#define CP_ROUTE_OS_M2     INPUT_MASK(VOCC_M2_OS)
+#define CP_ROUTE_OS_BOTH   (CP_ROUTE_OS_M1 | CP_ROUTE_OS_M2)
+
+// Any OS track occupied holds the turnouts where they are
+#define CP_OS_INPUTS  CP_ROUTE_OS_BOTH
+
+#define CP_ROUTE_E_XOVER   TURNOUT_MASK(TURNOUT_E_XOVER)
+#define CP_ROUTE_W_XOVER   TURNOUT_MASK(TURNOUT_W_XOVER)
+#define CP_ROUTE_M1_M3     TURNOUT_MASK(TURNOUT_M1_M3)
+#define CP_ROUTE_TURNOUTS_NONE  0
+#define CP_ROUTE_LOCK_XOVERS    (CP_ROUTE_E_XOVER | CP_ROUTE_W_XOVER)
+
+typedef struct
+{
+	uint8_t entrance;          // CPRouteEntrance_t the route is coded from
+	uint8_t route;             // CPRoute_t
+	uint8_t turnoutsNormal;    // Turnouts that have to be requested normal...
+	uint8_t turnoutsReversed;  //  ...or reversed for this route
+	uint8_t lockTurnouts;      // Turnouts locked while the route is set
+	CPRouteMask_t conflicts;   // Routes that can't already be set
+	CPInputMask_t osInputs;    // Occupancy on any of these drops the route
+	uint8_t aspectGroup;       // See below
+	uint8_t stopHead;          // Other head on the mast, held at stop
+	uint8_t clearHead;         // Head that gets the route's aspect
+	uint8_t occupancy[3];      // Blocks beyond, nearest first
+} CPRouteDef_t;
+
+/* Routes, in the order vitalLogic() works through them for aspects
+ *  Within an aspect group only the first route set counts.  Later groups
+ *  are applied over earlier ones, so a crossover route wins over a straight
+ *  route on the same head.
+ *
+ * M1 westbound on the west crossover reversed deliberately doesn't lock the
+ *  turnouts - that's how the original hand-written logic behaved.
+ */
+static const CPRouteDef_t cpRouteDefs[] PROGMEM =
+{
+	// Aspect group 0 - main 1 and main 3 straight through
+	{ ROUTE_ENTR_M1_EASTBOUND, ROUTE_MAIN1_EASTBOUND, CP_ROUTE_E_XOVER | CP_ROUTE_W_XOVER | CP_ROUTE_M1_M3, CP_ROUTE_TURNOUTS_NONE, CP_ROUTE_LOCK_XOVERS, ROUTE_CONFLICTS_MAIN1_EASTBOUND, CP_ROUTE_OS_M1,
+		0, SIG_MAIN1_W_LOWER, SIG_MAIN1_W_UPPER, { VOCC_M1E_ADJOIN, VOCC_M1E_APPROACH, VOCC_M1E_APPROACH2 } },
+	{ ROUTE_ENTR_M1_WESTBOUND, ROUTE_MAIN1_WESTBOUND, CP_ROUTE_E_XOVER | CP_ROUTE_W_XOVER | CP_ROUTE_M1_M3, CP_ROUTE_TURNOUTS_NONE, CP_ROUTE_LOCK_XOVERS, ROUTE_CONFLICTS_MAIN1_WESTBOUND, CP_ROUTE_OS_M1,
+		0, SIG_MAIN1_E_LOWER, SIG_MAIN1_E_UPPER, { VOCC_M1W_ADJOIN, VOCC_M1W_APPROACH, VOCC_M1W_APPROACH2 } },
+	{ ROUTE_ENTR_M1_WESTBOUND, ROUTE_MAIN1_TO_MAIN3_WESTBOUND, CP_ROUTE_E_XOVER | CP_ROUTE_W_XOVER, CP_ROUTE_M1_M3, CP_ROUTE_LOCK_XOVERS, ROUTE_CONFLICTS_MAIN1_TO_MAIN3_WESTBOUND, CP_ROUTE_OS_M1,
+		0, SIG_MAIN1_E_UPPER, SIG_MAIN1_E_LOWER, { VOCC_M3W_ADJOIN, VOCC_M3W_APPROACH, VOCC_M3W_APPROACH2 } },
+	{ ROUTE_ENTR_M3_EASTBOUND, ROUTE_MAIN3_TO_MAIN1_EASTBOUND, CP_ROUTE_E_XOVER | CP_ROUTE_W_XOVER, CP_ROUTE_M1_M3, CP_ROUTE_LOCK_XOVERS, ROUTE_CONFLICTS_MAIN3_TO_MAIN1_EASTBOUND, CP_ROUTE_OS_M1,
+		0, SIG_MAIN3_W_LOWER, SIG_MAIN3_W_UPPER, { VOCC_M1E_ADJOIN, VOCC_M1E_APPROACH, VOCC_M1E_APPROACH2 } },
+
+	// Aspect group 1 - main 2, straight through or via main 1
+	{ ROUTE_ENTR_M2_EASTBOUND, ROUTE_MAIN2_EASTBOUND, CP_ROUTE_E_XOVER | CP_ROUTE_W_XOVER, CP_ROUTE_TURNOUTS_NONE, CP_ROUTE_LOCK_XOVERS, ROUTE_CONFLICTS_MAIN2_EASTBOUND, CP_ROUTE_OS_M2,
+		1, SIG_MAIN2_W_LOWER, SIG_MAIN2_W_UPPER, { VOCC_M2E_ADJOIN, VOCC_M2E_APPROACH, VOCC_M2E_APPROACH2 } },
+	{ ROUTE_ENTR_M2_WESTBOUND, ROUTE_MAIN2_WESTBOUND, CP_ROUTE_E_XOVER | CP_ROUTE_W_XOVER, CP_ROUTE_TURNOUTS_NONE, CP_ROUTE_LOCK_XOVERS, ROUTE_CONFLICTS_MAIN2_WESTBOUND, CP_ROUTE_OS_M2,
+		1, SIG_MAIN2_E_LOWER, SIG_MAIN2_E_UPPER, { VOCC_M2W_ADJOIN, VOCC_M2W_APPROACH, VOCC_M2W_APPROACH2 } },
+	{ ROUTE_ENTR_M2_EASTBOUND, ROUTE_MAIN2_VIA_MAIN1_EASTBOUND, CP_ROUTE_TURNOUTS_NONE, CP_ROUTE_E_XOVER | CP_ROUTE_W_XOVER, CP_ROUTE_LOCK_XOVERS, ROUTE_CONFLICTS_MAIN2_VIA_MAIN1_EASTBOUND, CP_ROUTE_OS_BOTH,
+		1, SIG_MAIN2_W_UPPER, SIG_MAIN2_W_LOWER, { VOCC_M2E_ADJOIN, VOCC_M2E_APPROACH, VOCC_M2E_APPROACH2 } },
+	{ ROUTE_ENTR_M2_WESTBOUND, ROUTE_MAIN2_VIA_MAIN1_WESTBOUND, CP_ROUTE_TURNOUTS_NONE, CP_ROUTE_E_XOVER | CP_ROUTE_W_XOVER, CP_ROUTE_LOCK_XOVERS, ROUTE_CONFLICTS_MAIN2_VIA_MAIN1_WESTBOUND, CP_ROUTE_OS_BOTH,
+		1, SIG_MAIN2_E_UPPER, SIG_MAIN2_E_LOWER, { VOCC_M2W_ADJOIN, VOCC_M2W_APPROACH, VOCC_M2W_APPROACH2 } },
+
+	// Aspect group 2 - across a crossover
+	{ ROUTE_ENTR_M1_EASTBOUND, ROUTE_MAIN1_TO_MAIN2_EASTBOUND, CP_ROUTE_W_XOVER | CP_ROUTE_M1_M3, CP_ROUTE_E_XOVER, CP_ROUTE_LOCK_XOVERS, ROUTE_CONFLICTS_MAIN1_TO_MAIN2_EASTBOUND, CP_ROUTE_OS_BOTH,
+		2, SIG_MAIN1_W_UPPER, SIG_MAIN1_W_LOWER, { VOCC_M2E_ADJOIN, VOCC_M2E_APPROACH, VOCC_M2E_APPROACH2 } },
+	{ ROUTE_ENTR_M1_WESTBOUND, ROUTE_MAIN1_TO_MAIN2_WESTBOUND, CP_ROUTE_E_XOVER, CP_ROUTE_W_XOVER, CP_ROUTE_TURNOUTS_NONE, ROUTE_CONFLICTS_MAIN1_TO_MAIN2_WESTBOUND, CP_ROUTE_OS_BOTH,
+		2, SIG_MAIN1_E_UPPER, SIG_MAIN1_E_LOWER, { VOCC_M2W_ADJOIN, VOCC_M2W_APPROACH, VOCC_M2W_APPROACH2 } },
+	{ ROUTE_ENTR_M2_EASTBOUND, ROUTE_MAIN2_TO_MAIN1_EASTBOUND, CP_ROUTE_E_XOVER, CP_ROUTE_W_XOVER, CP_ROUTE_LOCK_XOVERS, ROUTE_CONFLICTS_MAIN2_TO_MAIN1_EASTBOUND, CP_ROUTE_OS_BOTH,
+		2, SIG_MAIN2_W_UPPER, SIG_MAIN2_W_LOWER, { VOCC_M1E_ADJOIN, VOCC_M1E_APPROACH, VOCC_M1E_APPROACH2 } },
+	{ ROUTE_ENTR_M2_WESTBOUND, ROUTE_MAIN2_TO_MAIN3_WESTBOUND, CP_ROUTE_W_XOVER, CP_ROUTE_E_XOVER | CP_ROUTE_M1_M3, CP_ROUTE_LOCK_XOVERS, ROUTE_CONFLICTS_MAIN2_TO_MAIN3_WESTBOUND, CP_ROUTE_OS_BOTH,
+		2, SIG_MAIN2_E_UPPER, SIG_MAIN2_E_LOWER, { VOCC_M3W_ADJOIN, VOCC_M3W_APPROACH, VOCC_M3W_APPROACH2 } },
+	{ ROUTE_ENTR_M3_EASTBOUND, ROUTE_MAIN3_TO_MAIN2_EASTBOUND, CP_ROUTE_W_XOVER, CP_ROUTE_E_XOVER | CP_ROUTE_M1_M3, CP_ROUTE_LOCK_XOVERS, ROUTE_CONFLICTS_MAIN3_TO_MAIN2_EASTBOUND, CP_ROUTE_OS_BOTH,
+		2, SIG_MAIN3_W_UPPER, SIG_MAIN3_W_LOWER, { VOCC_M2E_ADJOIN, VOCC_M2E_APPROACH, VOCC_M2E_APPROACH2 } },
+	{ ROUTE_ENTR_M2_WESTBOUND, ROUTE_MAIN2_TO_MAIN1_WESTBOUND, CP_ROUTE_W_XOVER | CP_ROUTE_M1_M3, CP_ROUTE_E_XOVER, CP_ROUTE_LOCK_XOVERS, ROUTE_CONFLICTS_MAIN2_TO_MAIN1_WESTBOUND, CP_ROUTE_OS_BOTH,
+		2, SIG_MAIN2_E_UPPER, SIG_MAIN2_E_LOWER, { VOCC_M1W_ADJOIN, VOCC_M1W_APPROACH, VOCC_M1W_APPROACH2 } },
+};
+
+#define CP_ROUTE_DEFS  (sizeof(cpRouteDefs) / sizeof(CPRouteDef_t))
+
+#endif
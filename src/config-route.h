@@ -22,7 +22,7 @@ LICENSE:
 #ifndef _CONFIG_ROUTE_H_
 #define _CONFIG_ROUTE_H_
 
-#define MAX_ROUTES 2
+#include <stdint.h>
 
 typedef enum
 {
@@ -41,9 +41,30 @@ typedef enum
 	ROUTE_MAIN3_TO_MAIN1_EASTBOUND,
 	ROUTE_MAIN3_TO_MAIN2_EASTBOUND,
 	ROUTE_MAIN1_TO_MAIN3_WESTBOUND,
-	ROUTE_MAIN2_TO_MAIN3_WESTBOUND
+	ROUTE_MAIN2_TO_MAIN3_WESTBOUND,
+	ROUTE_END
 } CPRoute_t;
 
+// Active routes are kept as a bitmask, one bit per CPRoute_t
+typedef uint16_t CPRouteMask_t;
+#define ROUTE_MASK(route)  ((CPRouteMask_t)1 << (route))
+
+// Opposing routes that can't be set while the given route is
+#define ROUTE_CONFLICTS_MAIN1_EASTBOUND            ROUTE_MASK(ROUTE_MAIN1_WESTBOUND)
+#define ROUTE_CONFLICTS_MAIN1_WESTBOUND            ROUTE_MASK(ROUTE_MAIN1_EASTBOUND)
+#define ROUTE_CONFLICTS_MAIN2_EASTBOUND            ROUTE_MASK(ROUTE_MAIN2_WESTBOUND)
+#define ROUTE_CONFLICTS_MAIN2_WESTBOUND            ROUTE_MASK(ROUTE_MAIN2_EASTBOUND)
+#define ROUTE_CONFLICTS_MAIN2_VIA_MAIN1_EASTBOUND  ROUTE_MASK(ROUTE_MAIN2_VIA_MAIN1_WESTBOUND)
+#define ROUTE_CONFLICTS_MAIN2_VIA_MAIN1_WESTBOUND  ROUTE_MASK(ROUTE_MAIN2_VIA_MAIN1_EASTBOUND)
+#define ROUTE_CONFLICTS_MAIN1_TO_MAIN2_EASTBOUND   ROUTE_MASK(ROUTE_MAIN2_TO_MAIN1_WESTBOUND)
+#define ROUTE_CONFLICTS_MAIN1_TO_MAIN2_WESTBOUND   ROUTE_MASK(ROUTE_MAIN2_TO_MAIN1_EASTBOUND)
+#define ROUTE_CONFLICTS_MAIN2_TO_MAIN1_EASTBOUND   ROUTE_MASK(ROUTE_MAIN1_TO_MAIN2_WESTBOUND)
+#define ROUTE_CONFLICTS_MAIN2_TO_MAIN1_WESTBOUND   ROUTE_MASK(ROUTE_MAIN1_TO_MAIN2_EASTBOUND)
+#define ROUTE_CONFLICTS_MAIN3_TO_MAIN1_EASTBOUND   ROUTE_MASK(ROUTE_MAIN1_TO_MAIN3_WESTBOUND)
+#define ROUTE_CONFLICTS_MAIN3_TO_MAIN2_EASTBOUND   ROUTE_MASK(ROUTE_MAIN2_TO_MAIN3_WESTBOUND)
+#define ROUTE_CONFLICTS_MAIN1_TO_MAIN3_WESTBOUND   ROUTE_MASK(ROUTE_MAIN3_TO_MAIN1_EASTBOUND)
+#define ROUTE_CONFLICTS_MAIN2_TO_MAIN3_WESTBOUND   ROUTE_MASK(ROUTE_MAIN3_TO_MAIN2_EASTBOUND)
+
 typedef enum
 {
 	ROUTE_ENTR_NONE,
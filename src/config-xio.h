@@ -0,0 +1,48 @@
+/*************************************************************************
+Title:    XIO Bus Configuration
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     config-xio.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _CONFIG_XIO_H_
+#define _CONFIG_XIO_H_
+
+#include "xio-driver.h"
+
+// Number of XIOs on the bus.  XIO n sits at I2C_XIO_ADDRESS(n), so they fill
+//  the address range from I2C_XIO0_ADDRESS down.  Pin directions aren't set
+//  here - any pin listed in CP_XIO_INPUT_PINS (config-hardware.h) is an
+//  input and everything else is an output.
+#define CP_XIO_COUNT  2
+
+#if CP_XIO_COUNT > XIO_MAX_DEVICES
+#error "CP_XIO_COUNT is more XIOs than there are addresses for"
+#endif
+
+// main() keeps CP_XIO_COUNT XIOControls, so XIO state costs CP_XIO_COUNT *
+//  XIO_RAM_BUDGET bytes - 512 with all XIO_MAX_DEVICES fitted (xio-driver.h
+//  checks the per-XIO size on the AVR build)
+
+// Outputs that aren't a turnout or a signal lamp - pins in CP_MISC_OUTPUT_PINS
+typedef enum
+{
+	MISC_TIMELOCK_LED,
+	MISC_OUTPUT_END  // Must be last entry
+} CPMiscOutputNames_t;
+
+#endif
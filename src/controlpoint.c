@@ -22,44 +22,292 @@ LICENSE:
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include "mrbus.h"
 #include "controlpoint.h"
 #include "config-hardware.h"
 #include <avr/eeprom.h>
+#include <util/atomic.h>
 
-void CPMRBusVirtInputFilter(CPState_t* state, const uint8_t const *mrbRxBuffer)
+// RAM index of the MRBus bit/byte rules, so an incoming packet only touches
+// the rules that share its (source, type) hash bucket instead of pulling
+// three EEPROM bytes for every virtual input
+#define CP_VINPUT_RULES        (sizeof(vInputConfigArray) / vInputConfigRecSize)
+#define CP_VINPUT_BUCKETS      8
+#define CP_VINPUT_RULE_NONE    0xFF
+#define CP_VINPUT_HASH(src, type)  (((src) ^ (type) ^ ((src) >> 3)) & (CP_VINPUT_BUCKETS - 1))
+
+typedef struct
+{
+	uint8_t pktSrc;
+	uint8_t pktType;
+	uint8_t byteNum;
+	uint8_t bitMask;
+	uint8_t inputID;
+	uint8_t source;  // Repeat cache slot for this (source, type), or CP_VINPUT_SOURCE_NONE
+	uint8_t next;
+} CPVirtInputRule_t;
+
+static CPVirtInputRule_t cpVirtInputRules[CP_VINPUT_RULES];
+static uint8_t cpVirtInputBuckets[CP_VINPUT_BUCKETS];
+
+// Neighbours re-send their status every couple of seconds whether anything
+//  changed or not.  The CRC of the last packet from each (source, type) the
+//  rules listen to is kept, and a repeat skips the rules.  A CRC can't tell
+//  every change apart, so every so often a repeat gets looked at anyway.
+#define CP_VINPUT_SOURCES      8
+#define CP_VINPUT_SOURCE_NONE  0xFF
+
+typedef struct
+{
+	bool valid;
+	uint8_t len;
+	uint8_t crcL;
+	uint8_t crcH;
+	uint8_t repeats;
+} CPVirtInputSource_t;
+
+static CPVirtInputSource_t cpVirtInputSources[CP_VINPUT_SOURCES];
+static uint32_t cpVirtInputRepeatsSkipped = 0;
+
+// The MRBus receive interrupt asks CPMRBusVirtInputInterested() about every
+//  packet, so it mustn't walk the index half built.  While this is clear it
+//  gets told everything is interesting instead - interrupts stay on through
+//  the EEPROM reads.  The atomic blocks are only there as compiler barriers,
+//  keeping the index writes between the two flag writes.
+static volatile bool cpVirtInputIndexReady = false;
+
+void CPVirtInputIndexRebuild(CPState_t* state)
+{
+	uint8_t i, numRules = 0;
+	uint8_t vInputConfigRec[vInputConfigRecSize];
+
+	uint8_t numSources = 0;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		cpVirtInputIndexReady = false;
+	}
+
+	for (i=0; i<CP_VINPUT_BUCKETS; i++)
+		cpVirtInputBuckets[i] = CP_VINPUT_RULE_NONE;
+
+	memset(cpVirtInputSources, 0, sizeof(cpVirtInputSources));
+
+	for (numRules=0; numRules < CP_VINPUT_RULES; numRules++)
+	{
+		memcpy_P(vInputConfigRec, &vInputConfigArray[numRules * vInputConfigRecSize], vInputConfigRecSize);
+
+		CPVirtInputRule_t* rule = &cpVirtInputRules[numRules];
+		uint8_t valPktBitByte = eeprom_read_byte((const uint8_t*)(uint16_t)vInputConfigRec[3]);
+		rule->pktSrc = eeprom_read_byte((const uint8_t*)(uint16_t)vInputConfigRec[1]);
+		rule->pktType = eeprom_read_byte((const uint8_t*)(uint16_t)vInputConfigRec[2]);
+		rule->byteNum = BITBYTE_BYTENUM(valPktBitByte);
+		rule->bitMask = BITBYTE_BITMASK(valPktBitByte);
+		rule->inputID = vInputConfigRec[0];
+
+		// Rules listening to the same (source, type) share a repeat cache slot
+		rule->source = CP_VINPUT_SOURCE_NONE;
+		for (i=0; i<numRules; i++)
+		{
+			if (cpVirtInputRules[i].pktSrc == rule->pktSrc && cpVirtInputRules[i].pktType == rule->pktType)
+			{
+				rule->source = cpVirtInputRules[i].source;
+				break;
+			}
+		}
+		if (i == numRules && numSources < CP_VINPUT_SOURCES)
+			rule->source = numSources++;
+
+		uint8_t bucket = CP_VINPUT_HASH(rule->pktSrc, rule->pktType);
+		rule->next = cpVirtInputBuckets[bucket];
+		cpVirtInputBuckets[bucket] = numRules;
+	}
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		cpVirtInputIndexReady = true;
+	}
+}
+
+// Whether any bit/byte rule listens to packets of this type from this source.
+//  Safe to call from the MRBus receive interrupt.
+bool CPMRBusVirtInputInterested(uint8_t pktSrc, uint8_t pktType)
 {
 	uint8_t i;
-	for (i=0; i<VINPUT_END; i++)
+
+	if (!cpVirtInputIndexReady)
+		return true;
+
+	i = cpVirtInputBuckets[CP_VINPUT_HASH(pktSrc, pktType)];
+
+	while (CP_VINPUT_RULE_NONE != i)
+	{
+		CPVirtInputRule_t* rule = &cpVirtInputRules[i];
+		if (rule->pktSrc == pktSrc && rule->pktType == pktType)
+			return true;
+		i = rule->next;
+	}
+	return false;
+}
+
+// Returns true if the packet is the same as the last one from its source
+static bool CPVirtInputRepeated(uint8_t source, const uint8_t *mrbRxBuffer)
+{
+	CPVirtInputSource_t* s = &cpVirtInputSources[source];
+
+	if (s->valid
+		&& s->len == mrbRxBuffer[MRBUS_PKT_LEN]
+		&& s->crcL == mrbRxBuffer[MRBUS_PKT_CRC_L]
+		&& s->crcH == mrbRxBuffer[MRBUS_PKT_CRC_H]
+		&& s->repeats < CP_VINPUT_REPEAT_MAX)
+	{
+		s->repeats++;
+		return true;
+	}
+
+	s->valid = true;
+	s->len = mrbRxBuffer[MRBUS_PKT_LEN];
+	s->crcL = mrbRxBuffer[MRBUS_PKT_CRC_L];
+	s->crcH = mrbRxBuffer[MRBUS_PKT_CRC_H];
+	s->repeats = 0;
+	return false;
+}
+
+uint32_t CPMRBusVirtInputRepeatsSkipped(void)
+{
+	return cpVirtInputRepeatsSkipped;
+}
+
+void CPMRBusVirtInputRepeatsReset(void)
+{
+	cpVirtInputRepeatsSkipped = 0;
+}
+
+void CPMRBusVirtInputFilter(CPState_t* state, const uint8_t *mrbRxBuffer)
+{
+	uint8_t pktSrc = mrbRxBuffer[MRBUS_PKT_SRC];
+	uint8_t pktType = mrbRxBuffer[MRBUS_PKT_TYPE];
+	uint8_t i = cpVirtInputBuckets[CP_VINPUT_HASH(pktSrc, pktType)];
+	bool firstRule = true;
+
+	while (CP_VINPUT_RULE_NONE != i)
 	{
-		if (!state->inputs[i].isVirtual)
+		CPVirtInputRule_t* rule = &cpVirtInputRules[i];
+		i = rule->next;
+
+		if (rule->pktSrc != pktSrc || rule->pktType != pktType)
 			continue;
-			
-		uint8_t valPktSrc = eeprom_read_byte((const uint8_t*)(uint16_t)state->inputs[i].pktSrc);
-		uint8_t valPktType = eeprom_read_byte((const uint8_t*)(uint16_t)state->inputs[i].pktType);
-		uint8_t valPktBitByte = eeprom_read_byte((const uint8_t*)(uint16_t)state->inputs[i].pktBitByte);
 
-		uint8_t byteNum = BITBYTE_BYTENUM(valPktBitByte);
-		uint8_t bitMask = BITBYTE_BITMASK(valPktBitByte);
+		// All the rules for this source share the one cache slot
+		if (firstRule)
+		{
+			firstRule = false;
+			if (CP_VINPUT_SOURCE_NONE != rule->source && CPVirtInputRepeated(rule->source, mrbRxBuffer))
+			{
+				cpVirtInputRepeatsSkipped++;
+				return;
+			}
+		}
 
-		if (mrbRxBuffer[MRBUS_PKT_SRC] != valPktSrc 
-			|| mrbRxBuffer[MRBUS_PKT_TYPE] != valPktType
-			|| byteNum > mrbRxBuffer[MRBUS_PKT_LEN])
+		if (rule->byteNum > mrbRxBuffer[MRBUS_PKT_LEN])
 			continue;
 
-		state->inputs[i].isSet = (mrbRxBuffer[byteNum] & bitMask)?true:false;
+		CPInputStateSet(state, rule->inputID, (mrbRxBuffer[rule->byteNum] & rule->bitMask)?true:false);
 	}
 }
 
-void CPXIOInputFilter(CPState_t* state, XIOControl* xio)
+// Only inputs sitting on debounced bits that actually changed get looked at
+//  Returns true if any XIO input changed state
+bool CPXIOInputFilter(CPState_t* state, XIOControl* xio)
 {
-	for (uint8_t i=0; i<VINPUT_END; i++)
+	uint8_t changed[CP_XIO_COUNT][5];
+	bool anyChanged = false;
+	CPInputMask_t before = state->inputs;
+	uint8_t i;
+
+	for (i=0; i<CP_XIO_COUNT; i++)
 	{
-		if (state->inputs[i].isVirtual)
-			continue;
+		if (xioDebouncedChangesTake(&xio[i], changed[i]))
+			anyChanged = true;
+	}
 
-		state->inputs[i].isSet = xioGetDebouncedIObyPortBit(&xio[state->inputs[i].pktSrc], state->inputs[i].pktType, state->inputs[i].pktBitByte);
+	if (!anyChanged)
+		return false;
+
+	for (i=0; i<sizeof(cpXioInputGather) / sizeof(CPXIOInputGather_t); i++)
+	{
+		CPXIOInputGather_t g;
+		memcpy_P(&g, &cpXioInputGather[i], sizeof(g));
+		if (changed[g.xioNum][g.port] & g.mask)
+			CPInputStateSet(state, g.inputID, (xioGetDebouncedPort(&xio[g.xioNum], g.port) & g.mask)?true:false);
 	}
+	return (before != state->inputs);
+}
+
+// Per-input debounce timing from CP_XIO_INPUT_PINS, one entry per XIO.  The
+//  XIO debouncers read these straight out of flash.
+static const XIODebouncePinWidths cpXioDebouncePinWidths[CP_XIO_COUNT] PROGMEM =
+{
+	CP_XIO_PIN_WIDTHS(0),
+#if CP_XIO_COUNT > 1
+	CP_XIO_PIN_WIDTHS(1),
+#endif
+#if CP_XIO_COUNT > 2
+	CP_XIO_PIN_WIDTHS(2),
+#endif
+#if CP_XIO_COUNT > 3
+	CP_XIO_PIN_WIDTHS(3),
+#endif
+#if CP_XIO_COUNT > 4
+	CP_XIO_PIN_WIDTHS(4),
+#endif
+#if CP_XIO_COUNT > 5
+	CP_XIO_PIN_WIDTHS(5),
+#endif
+#if CP_XIO_COUNT > 6
+	CP_XIO_PIN_WIDTHS(6),
+#endif
+#if CP_XIO_COUNT > 7
+	CP_XIO_PIN_WIDTHS(7),
+#endif
+};
+
+// Point the XIO debouncers at their per-input widths.  DEBOUNCE_PORT in
+//  either direction keeps the port's width for that one.
+void CPXIOInputFilterConfigure(CPState_t* state, XIOControl* xio)
+{
+	for (uint8_t i=0; i<CP_XIO_COUNT; i++)
+		xioSetDebouncePinWidths(&xio[i], &cpXioDebouncePinWidths[i]);
+}
+
+// Any pin an input is read from is an input, everything else drives something
+//  For the XIO pins, 0 is output, 1 is input - worked out at compile time
+#define CP_XIO_DIRECTIONS(n)  { (uint8_t)CP_INPUT_PINS(n), (uint8_t)(CP_INPUT_PINS(n) >> 8), \
+	(uint8_t)(CP_INPUT_PINS(n) >> 16), (uint8_t)(CP_INPUT_PINS(n) >> 24), (uint8_t)(CP_INPUT_PINS(n) >> 32) }
+
+static const uint8_t cpXioDirections[XIO_MAX_DEVICES][5] PROGMEM =
+{
+	CP_XIO_DIRECTIONS(0), CP_XIO_DIRECTIONS(1), CP_XIO_DIRECTIONS(2), CP_XIO_DIRECTIONS(3),
+	CP_XIO_DIRECTIONS(4), CP_XIO_DIRECTIONS(5), CP_XIO_DIRECTIONS(6), CP_XIO_DIRECTIONS(7)
+};
+
+void CPXIOPinDirectionsGet(uint8_t xioNum, uint8_t* direction)
+{
+	if (xioNum >= XIO_MAX_DEVICES)
+		memset(direction, 0, 5);
+	else
+		memcpy_P(direction, cpXioDirections[xioNum], 5);
+}
+
+void CPMiscOutputSet(XIOControl* xio, CPMiscOutputNames_t outputID, bool on)
+{
+	CPMiscOutput_t def;
+
+	if (outputID >= MISC_OUTPUT_END)
+		return;
+	memcpy_P(&def, &cpMiscOutputs[outputID], sizeof(def));
+	xioSetDeferredPort(&xio[def.xioNum], def.port, def.mask, on ? def.onLevel : def.onLevel ^ def.mask);
 }
 
 void CPInitializeTurnout(CPTurnout_t *turnout)
@@ -78,9 +326,10 @@ void CPInitializeTimelock(CPTimelock_t *timelock)
 
 void CPTurnoutLockSet(CPState_t *state, CPTurnoutNames_t turnoutID, bool setLock)
 {
-	if(turnoutID < TURNOUT_END)
+	if(turnoutID < TURNOUT_END && state->turnouts[turnoutID].isLocked != setLock)
 	{
 		state->turnouts[turnoutID].isLocked = setLock;
+		state->dirty |= CP_DIRTY_TURNOUTS;
 	}
 }
 
@@ -94,9 +343,11 @@ bool CPTurnoutLockGet(CPState_t *state, CPTurnoutNames_t turnoutID)
 
 void CPTurnoutRequestedDirectionSet(CPState_t *state, CPTurnoutNames_t turnoutID, bool setNormal)
 {
-	if(turnoutID < TURNOUT_END)
+	if(turnoutID < TURNOUT_END && state->turnouts[turnoutID].isRequestedNormal != setNormal)
 	{
 		state->turnouts[turnoutID].isRequestedNormal = setNormal;
+		state->expediteTurnouts = true;
+		state->dirty |= CP_DIRTY_TURNOUTS;
 	}
 }
 
@@ -109,17 +360,19 @@ bool CPTurnoutRequestedDirectionGet(CPState_t *state, CPTurnoutNames_t turnoutID
 
 void CPTurnoutManualOperationsSet(CPState_t *state, CPTurnoutNames_t turnoutID, bool setManual)
 {
-	if(turnoutID < TURNOUT_END)
+	if(turnoutID < TURNOUT_END && state->turnouts[turnoutID].isManual != setManual)
 	{
 		state->turnouts[turnoutID].isManual = setManual;
+		state->dirty |= CP_DIRTY_TURNOUTS;
 	}
 }
 
 void CPTurnoutActualDirectionSet(CPState_t *state, CPTurnoutNames_t turnoutID, bool setActual)
 {
-	if(turnoutID < TURNOUT_END)
+	if(turnoutID < TURNOUT_END && state->turnouts[turnoutID].isNormal != setActual)
 	{
 		state->turnouts[turnoutID].isNormal = setActual;
+		state->dirty |= CP_DIRTY_TURNOUTS;
 	}
 }
 
@@ -135,34 +388,60 @@ void CPInitializeSignalHead(SignalHeadAspect_t *sig)
 	*sig = ASPECT_RED;
 }
 
-bool CPInputStateGet(CPState_t* state, CPInputNames_t inputID)
+// Signal outputs are kept as two ready-made images of every XIO's signal pins,
+//  one for each blink phase.  A head's pins only get worked out again when its
+//  aspect changes; the rest of the time an output write is just a copy of the
+//  image for the current phase.
+static uint8_t cpSignalPinMask[CP_XIO_COUNT][5];
+static uint8_t cpSignalImage[2][CP_XIO_COUNT][5];  // Indexed by blinker phase
+static SignalHeadAspect_t cpSignalImageAspects[SIG_END];  // What the images show
+
+// How restrictive each aspect is, higher being more so.  Dark and anything
+//  the outputs can't show are treated as stop, same as CPSignalsToOutputs does.
+static const uint8_t aspectRestrictiveness[8] PROGMEM =
 {
-	if (inputID < VINPUT_END)
-		return state->inputs[inputID].isSet;
-
-	return false;
+	[ASPECT_GREEN]     = 0,
+	[ASPECT_FL_GREEN]  = 1,
+	[ASPECT_FL_YELLOW] = 2,
+	[ASPECT_YELLOW]    = 3,
+	[ASPECT_LUNAR]     = 4,
+	[ASPECT_FL_RED]    = 5,
+	[ASPECT_RED]       = 6,
+	[ASPECT_OFF]       = 6
+};
+
+static uint8_t CPAspectRestrictiveness(SignalHeadAspect_t aspect)
+{
+	return (aspect < sizeof(aspectRestrictiveness)) ? pgm_read_byte(&aspectRestrictiveness[aspect]) : 6;
 }
 
-bool CPInputStateSet(CPState_t* state, CPInputNames_t inputID, bool isSet)
+typedef char CPExpediteSignalsFits_t[(SIG_END <= 16) ? 1 : -1];
+
+// Compared against what the head is actually showing, not the last aspect the
+//  logic asked for - green to red to yellow inside one pass is still a drop
+//  from the green on the signal.
+static bool CPSignalHeadMoreRestrictive(CPSignalHeadNames_t head, SignalHeadAspect_t aspect)
 {
-	if (inputID < VINPUT_END)
-	{
-		state->inputs[inputID].isSet = isSet;
-		return true;
-	}
-	return false;
+	return CPAspectRestrictiveness(aspect) > CPAspectRestrictiveness(cpSignalImageAspects[head]);
 }
 
 void CPSignalHeadSetAspect(CPState_t *cpState, CPSignalHeadNames_t signalID, SignalHeadAspect_t aspect)
 {
-	if(signalID < SIG_END)
+	if(signalID < SIG_END && cpState->signalHeads[signalID] != aspect)
+	{
+		if (CPSignalHeadMoreRestrictive(signalID, aspect))
+			cpState->expediteSignals |= (1<<signalID);
+		else
+			cpState->expediteSignals &= ~(1<<signalID);
 		cpState->signalHeads[signalID] = aspect;
+		cpState->dirty |= CP_DIRTY_SIGNALS;
+	}
 }
 
 void CPSignalHeadAllSetAspect(CPState_t *cpState, SignalHeadAspect_t aspect)
 {
 	for(uint8_t i=0; i<SIG_END; i++)
-		cpState->signalHeads[i] = aspect;
+		CPSignalHeadSetAspect(cpState, i, aspect);
 }
 
 SignalHeadAspect_t CPSignalHeadGetAspect(CPState_t *cpState, CPSignalHeadNames_t signalID)
@@ -180,8 +459,11 @@ CPTimelockState_t CPTimelockStateGet(CPState_t *cpState, CPTimelockNames_t timel
 
 void CPTimelockStateSet(CPState_t *cpState, CPTimelockNames_t timelockID, CPTimelockState_t state)
 {
-	if(timelockID < TIMELOCK_END)
+	if(timelockID < TIMELOCK_END && cpState->timelocks[timelockID].state != state)
+	{
 		cpState->timelocks[timelockID].state = state;
+		cpState->dirty |= CP_DIRTY_TIMELOCKS;
+	}
 }
 
 void CPTimelockTimeSet(CPState_t *cpState, CPTimelockNames_t timelockID, uint8_t seconds)
@@ -199,171 +481,112 @@ uint8_t CPTimelockTimeGet(CPState_t *cpState, CPTimelockNames_t timelockID)
 
 void CPTurnoutsToOutputs(CPState_t *cpState, XIOControl* xio)
 {
+	cpState->expediteTurnouts = false;
 	for (uint8_t tid=0; tid<TURNOUT_END; tid++)
 	{
-		for (uint8_t j=0; j<sizeof(cpTurnoutPinDefs)/sizeof(TurnoutPinDefinition); j++)
-		{
-			if(cpTurnoutPinDefs[j].turnoutID == tid)
-			{
-				bool isRequestedNormal = cpState->turnouts[tid].isRequestedNormal;
-				
-				xioSetDeferredIObyPortBit(&xio[cpTurnoutPinDefs[j].xioNum], 
-					cpTurnoutPinDefs[j].controlByte, cpTurnoutPinDefs[j].controlBit,
-					(cpTurnoutPinDefs[j].isNormalLow)?!isRequestedNormal:isRequestedNormal);
-				break; // process next turnout
-			}
-		}
+		CPTurnoutOutput_t def;
+		memcpy_P(&def, &cpTurnoutOutputs[tid], sizeof(def));
+		uint8_t level = (cpState->turnouts[tid].isRequestedNormal) ? def.normalLevel : def.normalLevel ^ def.mask;
+		xioSetDeferredPort(&xio[def.xioNum], def.port, def.mask, level);
 	}
 }
 
-bool CPRouteSet(CPState_t *cpState, CPRoute_t route)
+// ROUTE_NONE takes bit 0, so every real route has to fit in the rest of CPRouteMask_t
+typedef char CPRouteMaskFits_t[(ROUTE_END <= 8 * sizeof(CPRouteMask_t)) ? 1 : -1];
+
+// Which lamps each aspect lights
+#define CP_LAMP_FLASHING  0x80
+static const uint8_t cpAspectLamps[8] PROGMEM =
 {
-	for(uint8_t i=0; i<sizeof(cpState->routes)/sizeof(CPRoute_t); i++)
+	[ASPECT_OFF]       = 0,
+	[ASPECT_GREEN]     = _BV(CP_LAMP_GREEN),
+	[ASPECT_YELLOW]    = _BV(CP_LAMP_YELLOW),
+	[ASPECT_FL_YELLOW] = _BV(CP_LAMP_YELLOW) | CP_LAMP_FLASHING,
+	[ASPECT_RED]       = _BV(CP_LAMP_RED),
+	[ASPECT_FL_GREEN]  = _BV(CP_LAMP_GREEN) | CP_LAMP_FLASHING,
+	[ASPECT_FL_RED]    = _BV(CP_LAMP_RED) | CP_LAMP_FLASHING,
+	[ASPECT_LUNAR]     = _BV(CP_LAMP_RED)  // Can't display, so make like red
+};
+
+static void CPSignalImageHeadBuild(CPSignalHeadNames_t head, SignalHeadAspect_t aspect)
+{
+	CPSignalOutput_t def;
+	uint8_t lamps = (aspect < sizeof(cpAspectLamps)) ? pgm_read_byte(&cpAspectLamps[aspect]) : _BV(CP_LAMP_RED);
+	uint8_t phase, lamp;
+
+	memcpy_P(&def, &cpSignalOutputs[head], sizeof(def));
+	for(phase=0; phase<2; phase++)
 	{
-		if (cpState->routes[i] == ROUTE_NONE || cpState->routes[i] == route)
+		uint8_t* image = cpSignalImage[phase][def.xioNum];
+		uint8_t lit = ((lamps & CP_LAMP_FLASHING) && !phase) ? 0 : lamps;
+
+		for(lamp=0; lamp<CP_LAMPS; lamp++)
 		{
-			cpState->routes[i] = route;
-			return true;
+			uint8_t level = (lit & _BV(lamp)) ? ~def.offLevel : def.offLevel;
+			image[def.port[lamp]] = (image[def.port[lamp]] & ~def.mask[lamp]) | (level & def.mask[lamp]);
 		}
 	}
-	return false;
+	cpSignalImageAspects[head] = aspect;
 }
 
-void CPRouteClear(CPState_t *cpState, CPRoute_t route)
+static void CPSignalImageInitialize(CPState_t *cpState)
 {
-	for(uint8_t i=0; i<sizeof(cpState->routes)/sizeof(CPRoute_t); i++)
-	{
-		if (cpState->routes[i] == route)
-			cpState->routes[i] = ROUTE_NONE;
-	}
-}
+	uint8_t head, lamp;
 
-void CPRouteAllClear(CPState_t *cpState)
-{
-	for(uint8_t i=0; i<sizeof(cpState->routes)/sizeof(CPRoute_t); i++)
-	{
-		cpState->routes[i] = ROUTE_NONE;
-	}
-}
+	memset(cpSignalPinMask, 0, sizeof(cpSignalPinMask));
+	memset(cpSignalImage, 0, sizeof(cpSignalImage));
 
-
-bool CPRouteTest(CPState_t *cpState, CPRoute_t route)
-{
-	for(uint8_t i=0; i<sizeof(cpState->routes)/sizeof(CPRoute_t); i++)
+	for(head=0; head<SIG_END; head++)
 	{
-		if (cpState->routes[i] == route)
-			return true;
+		CPSignalOutput_t def;
+		memcpy_P(&def, &cpSignalOutputs[head], sizeof(def));
+		for(lamp=0; lamp<CP_LAMPS; lamp++)
+			cpSignalPinMask[def.xioNum][def.port[lamp]] |= def.mask[lamp];
+		CPSignalImageHeadBuild(head, cpState->signalHeads[head]);
 	}
-	return false;
 }
 
-bool CPRouteNoneSet(CPState_t *cpState)
+static void CPSignalImageApply(XIOControl* xio, bool blinkerOn)
 {
-	for(uint8_t i=0; i<sizeof(cpState->routes)/sizeof(CPRoute_t); i++)
-	{
-		if (cpState->routes[i] != ROUTE_NONE)
-			return false;
-	}
-	return true;
+	uint8_t xioNum;
+	for(xioNum=0; xioNum<CP_XIO_COUNT; xioNum++)
+		xioSetDeferredOutputs(&xio[xioNum], cpSignalPinMask[xioNum], cpSignalImage[blinkerOn?1:0][xioNum]);
 }
 
 void CPSignalsToOutputs(CPState_t *cpState, XIOControl* xio, bool blinkerOn)
 {
-	uint8_t sigDefIdx;
-	for(sigDefIdx=0; sigDefIdx<SIG_END; sigDefIdx++)
+	uint8_t head;
+	for(head=0; head<SIG_END; head++)
 	{
-		uint8_t xioNum = cpSignalPinDefs[sigDefIdx].xioNum;
-		uint8_t redByte = cpSignalPinDefs[sigDefIdx].redByte;
-		uint8_t redBit = cpSignalPinDefs[sigDefIdx].redBit;
-		uint8_t yellowByte = cpSignalPinDefs[sigDefIdx].yellowByte;
-		uint8_t yellowBit = cpSignalPinDefs[sigDefIdx].yellowBit;
-		uint8_t greenByte = cpSignalPinDefs[sigDefIdx].greenByte;
-		uint8_t greenBit = cpSignalPinDefs[sigDefIdx].greenBit;
-		bool inactiveState = (cpSignalPinDefs[sigDefIdx].isCommonAnode)?XIO_HIGH:XIO_LOW;
-		bool activeState = !inactiveState;
-
-		xioSetDeferredIObyPortBit(&xio[xioNum], redByte, redBit, inactiveState);
-		xioSetDeferredIObyPortBit(&xio[xioNum], yellowByte, yellowBit, inactiveState);
-		xioSetDeferredIObyPortBit(&xio[xioNum], greenByte, greenBit, inactiveState);
-
-		switch(cpState->signalHeads[cpSignalPinDefs[sigDefIdx].signalHead])
-		{
-			case ASPECT_OFF:
-				break;
-		
-			case ASPECT_GREEN:
-				xioSetDeferredIObyPortBit(&xio[xioNum], greenByte, greenBit, activeState);
-				break;
-		
-			case ASPECT_FL_GREEN:
-				if (blinkerOn)
-					xioSetDeferredIObyPortBit(&xio[xioNum], greenByte, greenBit, activeState);
-				break;
-
-			case ASPECT_YELLOW:
-				xioSetDeferredIObyPortBit(&xio[xioNum], yellowByte, yellowBit, activeState);
-				break;
-		
-			case ASPECT_FL_YELLOW:
-				if (blinkerOn)
-					xioSetDeferredIObyPortBit(&xio[xioNum], yellowByte, yellowBit, activeState);
-				break;
-
-			case ASPECT_RED:
-			case ASPECT_LUNAR: // Can't display, so make like red
-			default:
-				xioSetDeferredIObyPortBit(&xio[xioNum], redByte, redBit, activeState);
-				break;
-
-			case ASPECT_FL_RED:
-				if (blinkerOn)
-					xioSetDeferredIObyPortBit(&xio[xioNum], redByte, redBit, activeState);
-				break;
-		}
+		if (cpState->signalHeads[head] != cpSignalImageAspects[head])
+			CPSignalImageHeadBuild(head, cpState->signalHeads[head]);
 	}
+	CPSignalImageApply(xio, blinkerOn);
+	cpState->expediteSignals = 0;
 }
 
-
-void CPInitializeInput(CPInput_t *input)
+// Only the heads that went more restrictive and the turnouts - everything
+//  else, including blinking, waits for the next CPSignalsToOutputs().
+//  blinkerOn should be the same phase the last regular write used.
+void CPExpeditedToOutputs(CPState_t *cpState, XIOControl* xio, bool blinkerOn)
 {
-	uint16_t i;
-	uint8_t vInputConfigRec[vInputConfigRecSize];
-	uint8_t xioInputConfigRec[xioInputConfigRecSize];
-	input->isVirtual = false;
-	input->isSet = false;
-	input->pktSrc = 0x00;
-	input->pktType = 0x00;
-	input->pktBitByte = 0x00;
-
-	for (i=0; i<sizeof(vInputConfigArray); i+=vInputConfigRecSize)
+	uint8_t head;
+	for(head=0; head<SIG_END; head++)
 	{
-		memcpy_P(vInputConfigRec, &vInputConfigArray[i], vInputConfigRecSize);
-		if (vInputConfigRec[0] == input->inputID)
-		{
-			input->isVirtual = true;
-			input->pktSrc = vInputConfigRec[1];
-			input->pktType = vInputConfigRec[2];
-			input->pktBitByte = vInputConfigRec[3];
-			return;
-		}
-	}
-	
-	for (i=0; i<sizeof(xioInputConfigArray); i+=xioInputConfigRecSize)
-	{
-		memcpy_P(xioInputConfigRec, &xioInputConfigArray[i], xioInputConfigRecSize);
-		if (xioInputConfigRec[0] == input->inputID)
-		{
-			input->pktSrc = xioInputConfigRec[1];
-			input->pktType = xioInputConfigRec[2];
-			input->pktBitByte = xioInputConfigRec[3];
-			return;
-		}
+		if ((cpState->expediteSignals & (1<<head)) && CPSignalHeadMoreRestrictive(head, cpState->signalHeads[head]))
+			CPSignalImageHeadBuild(head, cpState->signalHeads[head]);
 	}
+	cpState->expediteSignals = 0;
+	CPSignalImageApply(xio, blinkerOn);
+
+	if (cpState->expediteTurnouts)
+		CPTurnoutsToOutputs(cpState, xio);
 }
 
+
 void CPTimelockApply1HzTick(CPState_t* state)
 {
-	for (uint8_t i=0; i<sizeof(state->timelocks) / sizeof(CPTimelockState_t); i++)
+	for (uint8_t i=0; i<sizeof(state->timelocks) / sizeof(CPTimelock_t); i++)
 	{
 		if (state->timelocks[i].secs > 0)
 			state->timelocks[i].secs--;
@@ -380,16 +603,20 @@ void CPInitialize(CPState_t* state)
 	for (i=0; i<sizeof(state->turnouts) / sizeof(CPTurnout_t); i++)
 		CPInitializeTurnout(&state->turnouts[i]);
 
-	for (i=0; i<VINPUT_END; i++)
-	{
-		state->inputs[i].inputID = (CPInputNames_t)i;
-		CPInitializeInput(&state->inputs[i]);
-	}
+	state->inputs = 0;
 
 	for (i=0; i<sizeof(state->timelocks) / sizeof(CPTimelock_t); i++)
 		CPInitializeTimelock(&state->timelocks[i]);
 
-	CPRouteAllClear(state);
+	state->routes = 0;
+	state->expediteSignals = 0;
+	state->expediteTurnouts = false;
+
+	CPSignalImageInitialize(state);
+	CPVirtInputIndexRebuild(state);
+
+	// Everything is new
+	state->dirty = CP_DIRTY_ALL;
 
 }
 
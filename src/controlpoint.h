@@ -30,6 +30,7 @@ LICENSE:
 #include "config-signals.h"
 #include "config-inputs.h"
 #include "config-route.h"
+#include "config-xio.h"
 
 #define BITBYTE_BYTENUM(a)   ((a) & 0x1F)
 #define BITBYTE_BITNUM(a)    ((a)>>5)
@@ -58,34 +59,70 @@ typedef struct
 	bool isManual;
 } CPTurnout_t;
 
-typedef struct
-{
-	CPInputNames_t inputID;
-	bool isSet;
-	bool isVirtual;
-	uint8_t pktSrc;
-	uint8_t pktType;
-	uint8_t pktBitByte;
-} CPInput_t;
+// Input states are one bit each - where they come from lives in flash
+//  (vInputConfigArray, CP_XIO_INPUT_PINS), not in the state
+typedef uint32_t CPInputMask_t;
+#define INPUT_MASK(input)  ((CPInputMask_t)1 << (input))
+
+typedef char CPInputMaskWideEnough_t[(VINPUT_END <= 8 * sizeof(CPInputMask_t)) ? 1 : -1];
+
 
 
+// Dirty bits - set by the CPState_t mutators whenever they actually change
+//  something, so consumers like the status packet only redo work that matters
+#define CP_DIRTY_INPUTS     0x01
+#define CP_DIRTY_SIGNALS    0x02
+#define CP_DIRTY_TURNOUTS   0x04
+#define CP_DIRTY_TIMELOCKS  0x08
+#define CP_DIRTY_ROUTES     0x10
+#define CP_DIRTY_ALL        0x1F
+
 typedef struct 
 {
 	SignalHeadAspect_t signalHeads[SIG_END];
 	CPTurnout_t turnouts[TURNOUT_END];
-	CPInput_t inputs[VINPUT_END];
+	CPInputMask_t inputs;
 	CPTimelock_t timelocks[TIMELOCK_END];
-	CPRoute_t routes[MAX_ROUTES];
+	CPRouteMask_t routes;
+	uint8_t dirty;
+	uint16_t expediteSignals;  // Heads now more restrictive than what they're showing
+	bool expediteTurnouts;     // A turnout was commanded to move
 } CPState_t;
 
+// Restrictive changes don't wait for the regular output write
+static inline bool CPOutputsExpedited(CPState_t *cpState)
+{
+	return (0 != cpState->expediteSignals) || cpState->expediteTurnouts;
+}
+
+static inline void CPStateDirtySet(CPState_t *cpState, uint8_t dirtyMask)
+{
+	cpState->dirty |= dirtyMask;
+}
+
+// Returns the dirty bits and clears them
+static inline uint8_t CPStateDirtyTake(CPState_t *cpState)
+{
+	uint8_t dirty = cpState->dirty;
+	cpState->dirty = 0;
+	return dirty;
+}
+
 void CPInitialize(CPState_t* state);
 void CPInitializeSignalHead(SignalHeadAspect_t *sig);
-bool CPInputStateGet(CPState_t* state, CPInputNames_t inputID);
-bool CPInputStateSet(CPState_t* state, CPInputNames_t inputID, bool isSet);
 void CPSignalHeadSetAspect(CPState_t *cpState, CPSignalHeadNames_t signalID, SignalHeadAspect_t aspect);
 void CPSignalHeadAllSetAspect(CPState_t *cpState, SignalHeadAspect_t aspect);
-void CPMRBusVirtInputFilter(CPState_t* state, const uint8_t const *mrbRxBuffer);
-void CPXIOInputFilter(CPState_t* state, XIOControl* xio);
+void CPMRBusVirtInputFilter(CPState_t* state, const uint8_t *mrbRxBuffer);
+void CPVirtInputIndexRebuild(CPState_t* state);
+bool CPMRBusVirtInputInterested(uint8_t pktSrc, uint8_t pktType);
+// After this many skipped repeats from a source, the next one is applied anyway
+#define CP_VINPUT_REPEAT_MAX   8
+uint32_t CPMRBusVirtInputRepeatsSkipped(void);
+void CPMRBusVirtInputRepeatsReset(void);
+bool CPXIOInputFilter(CPState_t* state, XIOControl* xio);
+void CPXIOInputFilterConfigure(CPState_t* state, XIOControl* xio);
+void CPXIOPinDirectionsGet(uint8_t xioNum, uint8_t* direction);
+void CPMiscOutputSet(XIOControl* xio, CPMiscOutputNames_t outputID, bool on);
 
 // Turnout Functions
 void CPInitializeTurnout(CPTurnout_t *turnout);
@@ -109,12 +146,78 @@ SignalHeadAspect_t CPSignalHeadGetAspect(CPState_t *cpState, CPSignalHeadNames_t
 // Control point to physical hardware functions
 void CPTurnoutsToOutputs(CPState_t *cpState, XIOControl* xio);
 void CPSignalsToOutputs(CPState_t *cpState, XIOControl* xio, bool blinkerOn);
+void CPExpeditedToOutputs(CPState_t *cpState, XIOControl* xio, bool blinkerOn);
 void CPTurnoutsToOutputs(CPState_t *cpState, XIOControl* xio);
 
-bool CPRouteSet(CPState_t *cpState, CPRoute_t route);
-void CPRouteClear(CPState_t *cpState, CPRoute_t route);
-void CPRouteAllClear(CPState_t *cpState);
-bool CPRouteTest(CPState_t *cpState, CPRoute_t route);
-bool CPRouteNoneSet(CPState_t *cpState);
+// Input functions - inputs are a bitmask too
+static inline bool CPInputStateGet(CPState_t* state, CPInputNames_t inputID)
+{
+	return (state->inputs & INPUT_MASK(inputID))?true:false;
+}
+
+static inline bool CPInputStateSet(CPState_t* state, CPInputNames_t inputID, bool isSet)
+{
+	if (inputID >= VINPUT_END)
+		return false;
+
+	CPInputMask_t inputs = isSet ? (state->inputs | INPUT_MASK(inputID)) : (state->inputs & ~INPUT_MASK(inputID));
+	if (inputs != state->inputs)
+	{
+		state->inputs = inputs;
+		state->dirty |= CP_DIRTY_INPUTS;
+	}
+	return true;
+}
+
+static inline CPInputMask_t CPInputMaskGet(CPState_t* state)
+{
+	return state->inputs;
+}
+
+// Route functions - routes are a bitmask, so these are all single operations
+static inline void CPRouteMaskUpdate(CPState_t *cpState, CPRouteMask_t routes)
+{
+	if (routes != cpState->routes)
+	{
+		cpState->routes = routes;
+		cpState->dirty |= CP_DIRTY_ROUTES;
+	}
+}
+
+static inline bool CPRouteSet(CPState_t *cpState, CPRoute_t route)
+{
+	CPRouteMaskUpdate(cpState, cpState->routes | ROUTE_MASK(route));
+	return true;
+}
+
+static inline void CPRouteClear(CPState_t *cpState, CPRoute_t route)
+{
+	CPRouteMaskUpdate(cpState, cpState->routes & ~ROUTE_MASK(route));
+}
+
+static inline void CPRouteMaskClear(CPState_t *cpState, CPRouteMask_t routeMask)
+{
+	CPRouteMaskUpdate(cpState, cpState->routes & ~routeMask);
+}
+
+static inline void CPRouteAllClear(CPState_t *cpState)
+{
+	CPRouteMaskUpdate(cpState, 0);
+}
+
+static inline bool CPRouteTest(CPState_t *cpState, CPRoute_t route)
+{
+	return (cpState->routes & ROUTE_MASK(route))?true:false;
+}
+
+static inline bool CPRouteAnySet(CPState_t *cpState, CPRouteMask_t routeMask)
+{
+	return (cpState->routes & routeMask)?true:false;
+}
+
+static inline bool CPRouteNoneSet(CPState_t *cpState)
+{
+	return (0 == cpState->routes);
+}
 
 #endif
@@ -0,0 +1,38 @@
+/*************************************************************************
+Title:    Host Build I2C Master Shim
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/avr-i2c-master.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _HOST_AVR_I2C_MASTER_H_
+#define _HOST_AVR_I2C_MASTER_H_
+
+// Same calls as the avr-i2c library.  Transactions land on the simulated
+// XIOs in host-i2c.c; the bus stays "busy" for a number of polls that
+// scales with the bytes moved, so blocking callers show up as spins.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+void i2c_master_init(void);
+uint8_t i2c_busy(void);
+void i2c_transmit(uint8_t *msg, uint8_t msgSize, uint8_t sendStop);
+uint8_t i2c_receive(uint8_t *msg, uint8_t msgSize);
+uint8_t i2c_transaction_successful(void);
+
+#endif
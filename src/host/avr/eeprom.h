@@ -0,0 +1,38 @@
+/*************************************************************************
+Title:    Host Build AVR EEPROM Shim
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/avr/eeprom.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _HOST_AVR_EEPROM_H_
+#define _HOST_AVR_EEPROM_H_
+
+#include <stdint.h>
+
+// ATmega328P has 1k of EEPROM - the host keeps it in an array that
+// starts out erased (0xFF) and counts accesses for profiling.
+#define HOST_EEPROM_SIZE 1024
+
+extern uint8_t hostEeprom[HOST_EEPROM_SIZE];
+extern uint32_t hostEepromReads;
+extern uint32_t hostEepromWrites;
+
+uint8_t eeprom_read_byte(const uint8_t* addr);
+void eeprom_write_byte(uint8_t* addr, uint8_t value);
+
+#endif
@@ -0,0 +1,38 @@
+/*************************************************************************
+Title:    Host Build AVR Interrupt Shim
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/avr/interrupt.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _HOST_AVR_INTERRUPT_H_
+#define _HOST_AVR_INTERRUPT_H_
+
+// Interrupt handlers become ordinary functions that the host harness
+// calls to simulate the hardware raising them.
+
+#define ISR(vector) void vector(void)
+
+void TIMER0_COMPA_vect(void);
+void TIMER1_OVF_vect(void);
+void ADC_vect(void);
+void PCINT0_vect(void);
+
+static inline void sei(void) {}
+static inline void cli(void) {}
+
+#endif
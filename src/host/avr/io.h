@@ -0,0 +1,99 @@
+/*************************************************************************
+Title:    Host Build AVR Register Shim
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/avr/io.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _HOST_AVR_IO_H_
+#define _HOST_AVR_IO_H_
+
+// Stand-in for avr-libc's <avr/io.h> when building the control point
+// logic as a Linux executable.  Registers are plain variables defined in
+// host-avr.c so the firmware can poke at them without faulting.
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+extern volatile uint8_t MCUSR, WDTCSR;
+extern volatile uint8_t PORTB, DDRB, PINB;
+extern volatile uint8_t PORTC, DDRC, PINC;
+extern volatile uint8_t PORTD, DDRD, PIND;
+extern volatile uint8_t TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0, TIFR0;
+extern volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+extern volatile uint16_t hostTCNT1, OCR1A, OCR1B;
+extern volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2A, TIMSK2;
+extern volatile uint8_t ADMUX, ADCSRA, ADCSRB, DIDR0;
+extern volatile uint16_t ADC;
+extern volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+extern volatile uint8_t SMCR;
+
+// MCUSR / WDTCSR
+#define WDRF    3
+#define WDE     3
+#define WDCE    4
+
+// Timer 0
+#define WGM00   0
+#define WGM01   1
+#define CS00    0
+#define CS01    1
+#define CS02    2
+#define OCIE0A  1
+#define TOIE0   0
+
+// Timer 1
+#define WGM12   3
+#define CS10    0
+#define CS11    1
+#define CS12    2
+#define TOIE1   0
+#define OCIE1A  1
+#define TOV1    0
+
+// Host time only moves between loop passes, so on its own nothing timed
+//  against Timer1 would take any time at all.  Every read of TCNT1 costs
+//  HOST_TIMER1_COUNTS_PER_READ instead - see host-avr.c.
+#define HOST_TIMER1_COUNTS_PER_READ  1
+volatile uint16_t* hostTimer1Read(void);
+#define TCNT1   (*hostTimer1Read())
+
+// ADC
+#define ADPS0   0
+#define ADPS1   1
+#define ADPS2   2
+#define ADIE    3
+#define ADIF    4
+#define ADATE   5
+#define ADSC    6
+#define ADEN    7
+
+// Pin change interrupts
+#define PCIE0   0
+#define PCIE1   1
+#define PCIE2   2
+#define PCINT0  0
+#define PCINT1  1
+#define PCINT2  2
+
+// Port bits
+#define PB0     0
+#define PB1     1
+#define PB2     2
+
+#endif
@@ -0,0 +1,35 @@
+/*************************************************************************
+Title:    Host Build AVR Program Space Shim
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/avr/pgmspace.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _HOST_AVR_PGMSPACE_H_
+#define _HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+// No Harvard architecture here - flash tables are just const data
+#define PROGMEM
+#define memcpy_P(dest, src, n)  memcpy((dest), (src), (n))
+#define pgm_read_byte(addr)     (*(const uint8_t*)(addr))
+#define pgm_read_word(addr)     (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr)    (*(const uint32_t*)(addr))
+
+#endif
@@ -0,0 +1,36 @@
+/*************************************************************************
+Title:    Host Build AVR Sleep Shim
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/avr/sleep.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _HOST_AVR_SLEEP_H_
+#define _HOST_AVR_SLEEP_H_
+
+#define SLEEP_MODE_IDLE 0
+
+// Sleeping skips simulated time ahead to whatever interrupt would wake
+// the part next - the I2C transaction finishing or the next timer tick.
+void hostSleepCpu(void);
+
+#define set_sleep_mode(mode)  do { (void)(mode); } while(0)
+#define sleep_enable()        do { } while(0)
+#define sleep_disable()       do { } while(0)
+#define sleep_cpu()           hostSleepCpu()
+
+#endif
@@ -0,0 +1,34 @@
+/*************************************************************************
+Title:    Host Build AVR Watchdog Shim
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/avr/wdt.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _HOST_AVR_WDT_H_
+#define _HOST_AVR_WDT_H_
+
+#define WDTO_1S 6
+
+// The firmware kicks the watchdog once per main loop pass, so the host
+// harness uses it as the hook that advances simulated time.
+void hostWatchdogReset(void);
+
+#define wdt_reset()       hostWatchdogReset()
+#define wdt_enable(t)     do { (void)(t); } while(0)
+
+#endif
@@ -0,0 +1,72 @@
+/*************************************************************************
+Title:    Host Build AVR Peripheral Shim
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/host-avr.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+
+volatile uint8_t MCUSR, WDTCSR;
+volatile uint8_t PORTB, DDRB, PINB;
+volatile uint8_t PORTC, DDRC, PINC;
+volatile uint8_t PORTD, DDRD, PIND;
+volatile uint8_t TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0, TIFR0;
+volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+volatile uint16_t hostTCNT1, OCR1A, OCR1B;
+volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2A, TIMSK2;
+volatile uint8_t ADMUX, ADCSRA, ADCSRB, DIDR0;
+volatile uint16_t ADC;
+volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+volatile uint8_t SMCR;
+
+// Once Timer1 is running, each read moves it on - an overflow is left pending
+//  in TIFR1 for the harness to hand to the interrupt at the next pass
+volatile uint16_t* hostTimer1Read(void)
+{
+	if (TCCR1B & (_BV(CS10) | _BV(CS11) | _BV(CS12)))
+	{
+		if ((uint32_t)hostTCNT1 + HOST_TIMER1_COUNTS_PER_READ > 0xFFFF)
+			TIFR1 |= _BV(TOV1);
+		hostTCNT1 += HOST_TIMER1_COUNTS_PER_READ;
+	}
+	return &hostTCNT1;
+}
+
+uint8_t hostEeprom[HOST_EEPROM_SIZE];
+uint32_t hostEepromReads = 0;
+uint32_t hostEepromWrites = 0;
+
+uint8_t eeprom_read_byte(const uint8_t* addr)
+{
+	uint16_t a = (uint16_t)(uintptr_t)addr;
+	hostEepromReads++;
+	if (a >= HOST_EEPROM_SIZE)
+		return 0xFF;
+	return hostEeprom[a];
+}
+
+void eeprom_write_byte(uint8_t* addr, uint8_t value)
+{
+	uint16_t a = (uint16_t)(uintptr_t)addr;
+	hostEepromWrites++;
+	if (a < HOST_EEPROM_SIZE)
+		hostEeprom[a] = value;
+}
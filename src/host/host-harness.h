@@ -0,0 +1,52 @@
+/*************************************************************************
+Title:    Host Build Harness Interface
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/host-harness.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _HOST_HARNESS_H_
+#define _HOST_HARNESS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Simulated MRBus
+extern bool hostMRBusInitialized;
+void hostMRBusTransmitted(const uint8_t* pkt, uint8_t len);
+
+// Simulated XIO (PCA9506) devices on the I2C bus
+#define HOST_XIO_MAX  8
+
+typedef struct
+{
+	uint32_t transactions;
+	uint32_t bytes;
+	uint32_t busySpins;
+	uint32_t nacks;
+} HostI2CStats;
+
+extern HostI2CStats hostI2CStats;
+
+void hostXioAttach(uint8_t xioNum, uint8_t address);
+void hostXioSetInputPin(uint8_t xioNum, uint8_t port, uint8_t bit, bool level);
+bool hostXioGetOutputPin(uint8_t xioNum, uint8_t port, uint8_t bit);
+void hostXioGetOutputs(uint8_t xioNum, uint8_t* outputs);
+void hostI2CAdvance(void);
+bool hostI2CFinish(void);
+
+#endif
@@ -0,0 +1,273 @@
+/*************************************************************************
+Title:    Host Build Simulated XIO I2C Bus
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/host-i2c.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+// Models enough of a PCA9506 40-bit expander to stand in for an XIO:
+/* 0x00-0x04 - input registers */
+/* 0x08-0x0C - output registers */
+/* 0x10-0x14 - polarity inversion registers */
+/* 0x18-0x1C - direction registers - 0 is output, 1 is input */
+/* 0x20-0x24 - interrupt mask registers - 1 is masked */
+// Bit 7 of the command byte turns on register auto-increment.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "avr-i2c-master.h"
+#include "xio-hardware-def.h"
+#include "host-harness.h"
+
+typedef struct
+{
+	bool present;
+	uint8_t address;
+	uint8_t pins[5];
+	uint8_t regs[0x28];
+	uint8_t pointer;
+	uint8_t lastRead[5];
+} HostXio;
+
+static HostXio hostXio[HOST_XIO_MAX];
+static uint8_t busyPolls = 0;
+static bool lastSuccessful = true;
+static bool irqAsserted = false;
+static bool twiWakePending = false;
+static uint8_t rxBuffer[8];
+static uint8_t rxLen = 0;
+
+HostI2CStats hostI2CStats;
+
+static HostXio* hostXioFind(uint8_t address)
+{
+	for (uint8_t i=0; i<HOST_XIO_MAX; i++)
+	{
+		if (hostXio[i].present && hostXio[i].address == (address & 0xFE))
+			return &hostXio[i];
+	}
+	return NULL;
+}
+
+static void hostXioReset(HostXio* x)
+{
+	memset(x->regs, 0, sizeof(x->regs));
+	memset(&x->regs[0x18], 0xFF, 5);
+	memset(&x->regs[0x20], 0xFF, 5);
+	x->pointer = 0;
+	memset(x->lastRead, 0, sizeof(x->lastRead));
+}
+
+static uint8_t hostXioReadReg(HostXio* x, uint8_t reg)
+{
+	if (reg < 5)
+	{
+		uint8_t ioc = x->regs[0x18 + reg];
+		uint8_t val = (x->pins[reg] & ioc) | (x->regs[0x08 + reg] & ~ioc);
+		return val ^ x->regs[0x10 + reg];
+	}
+	return (reg < sizeof(x->regs)) ? x->regs[reg] : 0xFF;
+}
+
+// The PCA9506 pulls the shared, open drain INT line low whenever an unmasked
+//  input differs from what was last read out of its input register.
+static bool hostXioIrq(HostXio* x)
+{
+	for (uint8_t i=0; i<5; i++)
+	{
+		uint8_t unmasked = x->regs[0x18 + i] & ~x->regs[0x20 + i];
+		if ((hostXioReadReg(x, i) ^ x->lastRead[i]) & unmasked)
+			return true;
+	}
+	return false;
+}
+
+static void hostI2CUpdateIrq(void)
+{
+	bool asserted = false;
+
+	for (uint8_t i=0; i<HOST_XIO_MAX; i++)
+	{
+		if (hostXio[i].present && hostXioIrq(&hostXio[i]))
+			asserted = true;
+	}
+
+	if (asserted)
+		PINB &= ~_BV(I2C_IRQ);
+	else
+		PINB |= _BV(I2C_IRQ);
+
+	// Any edge on an enabled pin fires the pin change interrupt
+	if (asserted != irqAsserted && (PCICR & _BV(PCIE0)) && (PCMSK0 & _BV(PCINT2)))
+	{
+		irqAsserted = asserted;
+		PCINT0_vect();
+	}
+	irqAsserted = asserted;
+}
+
+static void hostXioAdvancePointer(HostXio* x)
+{
+	if (x->pointer & 0x80)
+	{
+		uint8_t reg = x->pointer & 0x7F;
+		// Auto-increment wraps within each bank of five registers
+		reg = ((reg & 0x07) >= 4) ? (reg & 0xF8) : reg + 1;
+		x->pointer = 0x80 | reg;
+	}
+}
+
+void hostXioAttach(uint8_t xioNum, uint8_t address)
+{
+	if (xioNum >= HOST_XIO_MAX)
+		return;
+	hostXio[xioNum].present = true;
+	hostXio[xioNum].address = address;
+	hostXioReset(&hostXio[xioNum]);
+}
+
+void hostXioSetInputPin(uint8_t xioNum, uint8_t port, uint8_t bit, bool level)
+{
+	if (xioNum >= HOST_XIO_MAX || port >= 5)
+		return;
+	if (level)
+		hostXio[xioNum].pins[port] |= (1<<bit);
+	else
+		hostXio[xioNum].pins[port] &= ~(1<<bit);
+	hostI2CUpdateIrq();
+}
+
+bool hostXioGetOutputPin(uint8_t xioNum, uint8_t port, uint8_t bit)
+{
+	uint8_t outputs[5];
+	hostXioGetOutputs(xioNum, outputs);
+	return (outputs[port] & (1<<bit)) ? true : false;
+}
+
+void hostXioGetOutputs(uint8_t xioNum, uint8_t* outputs)
+{
+	for (uint8_t i=0; i<5; i++)
+		outputs[i] = hostXio[xioNum].regs[0x08 + i] & ~hostXio[xioNum].regs[0x18 + i];
+}
+
+void i2c_master_init(void)
+{
+	busyPolls = 0;
+	lastSuccessful = true;
+}
+
+uint8_t i2c_busy(void)
+{
+	if (busyPolls)
+	{
+		// A transaction finishing here - say, between the firmware checking
+		//  for work and going to sleep - leaves the TWI interrupt to wake it
+		if (0 == --busyPolls)
+			twiWakePending = true;
+		hostI2CStats.busySpins++;
+		return 1;
+	}
+	return 0;
+}
+
+// Bus time also passes while the main loop is off doing other work
+void hostI2CAdvance(void)
+{
+	if (busyPolls)
+		busyPolls--;
+	twiWakePending = false;
+}
+
+// What the TWI interrupt finishing the transaction would wake the CPU for
+bool hostI2CFinish(void)
+{
+	if (0 == busyPolls && !twiWakePending)
+		return false;
+	busyPolls = 0;
+	twiWakePending = false;
+	return true;
+}
+
+uint8_t i2c_transaction_successful(void)
+{
+	return lastSuccessful ? 1 : 0;
+}
+
+void i2c_transmit(uint8_t *msg, uint8_t msgSize, uint8_t sendStop)
+{
+	HostXio* x;
+	uint8_t i;
+
+	// Like the real driver, wait for any previous transaction to finish
+	while(i2c_busy());
+
+	hostI2CStats.transactions++;
+	hostI2CStats.bytes += msgSize;
+	busyPolls = msgSize;
+
+	x = hostXioFind(msg[0]);
+	if (NULL == x)
+	{
+		hostI2CStats.nacks++;
+		lastSuccessful = false;
+		return;
+	}
+	lastSuccessful = true;
+
+	if (msg[0] & 0x01)
+	{
+		// Read - fill the receive buffer from the current register pointer
+		rxBuffer[0] = msg[0];
+		rxLen = (msgSize < sizeof(rxBuffer)) ? msgSize : sizeof(rxBuffer);
+		for (i=1; i<rxLen; i++)
+		{
+			uint8_t reg = x->pointer & 0x7F;
+			rxBuffer[i] = hostXioReadReg(x, reg);
+			// Reading an input register clears its part of the interrupt
+			if (reg < 5)
+				x->lastRead[reg] = rxBuffer[i];
+			hostXioAdvancePointer(x);
+		}
+	}
+	else if (msgSize >= 2)
+	{
+		x->pointer = msg[1];
+		for (i=2; i<msgSize; i++)
+		{
+			uint8_t reg = x->pointer & 0x7F;
+			if (reg >= 0x08 && reg < sizeof(x->regs))
+				x->regs[reg] = msg[i];
+			hostXioAdvancePointer(x);
+		}
+	}
+	hostI2CUpdateIrq();
+	(void)sendStop;
+}
+
+uint8_t i2c_receive(uint8_t *msg, uint8_t msgSize)
+{
+	while(i2c_busy());
+
+	if (!lastSuccessful)
+		return 0;
+
+	memcpy(msg, rxBuffer, (msgSize < rxLen) ? msgSize : rxLen);
+	return 1;
+}
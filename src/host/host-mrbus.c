@@ -0,0 +1,162 @@
+/*************************************************************************
+Title:    Host Build MRBus Shim
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/host-mrbus.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "mrbus.h"
+#include "host-harness.h"
+
+MRBusPktQueue mrbusRxQueue;
+MRBusPktQueue mrbusTxQueue;
+
+void mrbusPktQueueInitialize(MRBusPktQueue* q, MRBusPacket* pktBufferArray, uint8_t pktBufferArraySz)
+{
+	q->pktBufferArray = pktBufferArray;
+	q->pktBufferArraySz = pktBufferArraySz;
+	q->headIdx = q->tailIdx = 0;
+	q->full = false;
+}
+
+bool mrbusPktQueueEmpty(MRBusPktQueue* q)
+{
+	return ((q->headIdx == q->tailIdx) && !q->full);
+}
+
+bool mrbusPktQueueFull(MRBusPktQueue* q)
+{
+	return (q->full);
+}
+
+uint8_t mrbusPktQueueDepth(MRBusPktQueue* q)
+{
+	if (q->full)
+		return (q->pktBufferArraySz);
+	return ((uint8_t)(q->headIdx + q->pktBufferArraySz - q->tailIdx) % q->pktBufferArraySz);
+}
+
+bool mrbusPktQueuePush(MRBusPktQueue* q, uint8_t* data, uint8_t dataLen)
+{
+	if (mrbusPktQueueFull(q))
+		return false;
+
+	memset(q->pktBufferArray[q->headIdx].pkt, 0, sizeof(MRBusPacket));
+	memcpy(q->pktBufferArray[q->headIdx].pkt, data, min(sizeof(MRBusPacket), dataLen));
+
+	if (++q->headIdx >= q->pktBufferArraySz)
+		q->headIdx = 0;
+	if (q->headIdx == q->tailIdx)
+		q->full = true;
+	return true;
+}
+
+uint8_t mrbusPktQueuePeek(MRBusPktQueue* q, uint8_t* data, uint8_t dataLen)
+{
+	if (mrbusPktQueueEmpty(q))
+		return 0;
+
+	uint8_t len = min(dataLen, sizeof(MRBusPacket));
+	memcpy(data, q->pktBufferArray[q->tailIdx].pkt, len);
+	return len;
+}
+
+void mrbusPktQueueDrop(MRBusPktQueue* q)
+{
+	if (mrbusPktQueueEmpty(q))
+		return;
+
+	if (++q->tailIdx >= q->pktBufferArraySz)
+		q->tailIdx = 0;
+	q->full = false;
+}
+
+uint8_t mrbusPktQueuePop(MRBusPktQueue* q, uint8_t* data, uint8_t dataLen)
+{
+	uint8_t len = mrbusPktQueuePeek(q, data, dataLen);
+	if (len)
+		mrbusPktQueueDrop(q);
+	return len;
+}
+
+uint16_t mrbusCRC16Update(uint16_t crc, uint8_t a)
+{
+	static const uint8_t MRBus_CRC16_HighTable[16] =
+		{ 0x00, 0xA0, 0xE0, 0x40, 0x60, 0xC0, 0x80, 0x20, 0xC0, 0x60, 0x20, 0x80, 0xA0, 0x00, 0x40, 0xE0 };
+	static const uint8_t MRBus_CRC16_LowTable[16] =
+		{ 0x00, 0x01, 0x03, 0x02, 0x07, 0x06, 0x04, 0x05, 0x0E, 0x0F, 0x0D, 0x0C, 0x09, 0x08, 0x0A, 0x0B };
+	uint8_t crc16_high = (crc >> 8) & 0xFF;
+	uint8_t crc16_low = crc & 0xFF;
+	uint8_t t, w, i;
+
+	for (i=0; i<2; i++)
+	{
+		if (i)
+		{
+			w = ((crc16_high << 4) & 0xF0) | ((crc16_high >> 4) & 0x0F);
+			t = (w ^ a) & 0x0F;
+		}
+		else
+		{
+			w = (crc16_high ^ a) & 0xF0;
+			t = ((w << 4) & 0xF0) | ((w >> 4) & 0x0F);
+		}
+		crc16_high = (crc16_high << 4) | (crc16_low >> 4);
+		crc16_low = crc16_low << 4;
+		crc16_high ^= MRBus_CRC16_HighTable[t];
+		crc16_low ^= MRBus_CRC16_LowTable[t];
+	}
+
+	return (((uint16_t)crc16_high << 8) | crc16_low);
+}
+
+void mrbusInit(void)
+{
+	hostMRBusInitialized = true;
+}
+
+uint8_t mrbusTransmit(void)
+{
+	uint8_t pkt[MRBUS_BUFFER_SIZE];
+	uint16_t crc = 0;
+	uint8_t len, i;
+
+	if (0 == mrbusPktQueuePeek(&mrbusTxQueue, pkt, sizeof(pkt)))
+		return 0;
+
+	len = min(pkt[MRBUS_PKT_LEN], sizeof(pkt));
+
+	for (i=0; i<len; i++)
+	{
+		if (i != MRBUS_PKT_CRC_H && i != MRBUS_PKT_CRC_L)
+			crc = mrbusCRC16Update(crc, pkt[i]);
+	}
+	pkt[MRBUS_PKT_CRC_L] = UINT16_LOW_BYTE(crc);
+	pkt[MRBUS_PKT_CRC_H] = UINT16_HIGH_BYTE(crc);
+
+	hostMRBusTransmitted(pkt, len);
+	mrbusPktQueueDrop(&mrbusTxQueue);
+	return 0;
+}
+
+bool mrbusIsBusIdle(void)
+{
+	return true;
+}
@@ -0,0 +1,92 @@
+/*************************************************************************
+Title:    Host Build MRBus Shim
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/mrbus.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _HOST_MRBUS_H_
+#define _HOST_MRBUS_H_
+
+// Mirrors the parts of the mrbus library API (mrbus.h / mrbus-avr.h) that
+// the control point uses.  The queue and CRC behave like the library
+// versions; the "bus" is a log that the host harness inspects.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MRBUS_PKT_DEST      0
+#define MRBUS_PKT_SRC       1
+#define MRBUS_PKT_LEN       2
+#define MRBUS_PKT_CRC_L     3
+#define MRBUS_PKT_CRC_H     4
+#define MRBUS_PKT_TYPE      5
+#define MRBUS_PKT_SUBTYPE   6
+
+#define MRBUS_BUFFER_SIZE   0x14
+
+#define MRBUS_EE_DEVICE_ADDR       0
+#define MRBUS_EE_DEVICE_OPT_FLAGS  1
+#define MRBUS_EE_DEVICE_UPDATE_H   2
+#define MRBUS_EE_DEVICE_UPDATE_L   3
+
+#define MRBUS_VERSION_WIRED   0x01
+
+#define UINT16_HIGH_BYTE(a)  ((uint8_t)((a)>>8))
+#define UINT16_LOW_BYTE(a)   ((uint8_t)((a) & 0xFF))
+
+#ifndef min
+#define min(a,b)  ((a)<(b)?(a):(b))
+#endif
+
+#ifndef max
+#define max(a,b)  ((a)>(b)?(a):(b))
+#endif
+
+typedef struct
+{
+	uint8_t pkt[MRBUS_BUFFER_SIZE];
+} MRBusPacket;
+
+typedef struct
+{
+	volatile uint8_t headIdx;
+	volatile uint8_t tailIdx;
+	volatile bool full;
+	MRBusPacket* pktBufferArray;
+	uint8_t pktBufferArraySz;
+} MRBusPktQueue;
+
+extern MRBusPktQueue mrbusRxQueue;
+extern MRBusPktQueue mrbusTxQueue;
+
+void mrbusPktQueueInitialize(MRBusPktQueue* q, MRBusPacket* pktBufferArray, uint8_t pktBufferArraySz);
+bool mrbusPktQueueEmpty(MRBusPktQueue* q);
+bool mrbusPktQueueFull(MRBusPktQueue* q);
+uint8_t mrbusPktQueueDepth(MRBusPktQueue* q);
+bool mrbusPktQueuePush(MRBusPktQueue* q, uint8_t* data, uint8_t dataLen);
+uint8_t mrbusPktQueuePeek(MRBusPktQueue* q, uint8_t* data, uint8_t dataLen);
+uint8_t mrbusPktQueuePop(MRBusPktQueue* q, uint8_t* data, uint8_t dataLen);
+void mrbusPktQueueDrop(MRBusPktQueue* q);
+
+uint16_t mrbusCRC16Update(uint16_t crc, uint8_t a);
+
+void mrbusInit(void);
+uint8_t mrbusTransmit(void);
+bool mrbusIsBusIdle(void);
+
+#endif
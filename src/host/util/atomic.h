@@ -0,0 +1,31 @@
+/*************************************************************************
+Title:    Host Build AVR Atomic Block Shim
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/util/atomic.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _HOST_UTIL_ATOMIC_H_
+#define _HOST_UTIL_ATOMIC_H_
+
+// The host harness only "interrupts" between main loop passes, so an
+// atomic block is just a block that runs once.
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type)  for(uint8_t __atomicOnce = 1; __atomicOnce; __atomicOnce = 0)
+
+#endif
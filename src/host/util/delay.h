@@ -0,0 +1,29 @@
+/*************************************************************************
+Title:    Host Build AVR Delay Shim
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/util/delay.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _HOST_UTIL_DELAY_H_
+#define _HOST_UTIL_DELAY_H_
+
+// Busy-wait delays cost nothing on the host
+#define _delay_us(us)  do { (void)(us); } while(0)
+#define _delay_ms(ms)  do { (void)(ms); } while(0)
+
+#endif
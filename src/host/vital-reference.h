@@ -0,0 +1,630 @@
+/*************************************************************************
+Title:    Reference Signal Aspect Logic
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/vital-reference.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+// The hand-written route and aspect logic from before config-aspects.h and
+//  config-route-table.h, kept only so "mrb-xo3-host verify" has something to
+//  check the tables against.  Don't change it to match the tables - that
+//  defeats the point.
+
+#ifndef _VITAL_REFERENCE_H_
+#define _VITAL_REFERENCE_H_
+
+static void hostLockAllTurnoutsReference(CPState_t* state)
+{
+	CPTurnoutLockSet(state, TURNOUT_E_XOVER, true);
+	CPTurnoutLockSet(state, TURNOUT_W_XOVER, true);
+}
+
+static void hostVitalRoutesReference(CPState_t *cpState)
+{
+	bool occupancyMain1 = CPInputStateGet(cpState, VOCC_M1_OS);
+	bool occupancyMain2 = CPInputStateGet(cpState, VOCC_M2_OS);
+
+	// First, if we have occupancy, drop any routes affected
+	if (occupancyMain1 || occupancyMain2)
+	{
+		CPRouteMaskClear(cpState, ROUTE_MASK(ROUTE_MAIN2_VIA_MAIN1_EASTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN2_VIA_MAIN1_WESTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN1_TO_MAIN2_EASTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN1_TO_MAIN2_WESTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN2_TO_MAIN1_EASTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN2_TO_MAIN1_WESTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN3_TO_MAIN2_EASTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN2_TO_MAIN3_WESTBOUND));
+	}
+	
+	if (occupancyMain1)
+	{
+		CPRouteMaskClear(cpState, ROUTE_MASK(ROUTE_MAIN1_EASTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN1_WESTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN1_TO_MAIN3_WESTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN3_TO_MAIN1_EASTBOUND));
+	}
+	
+	if (occupancyMain2)
+	{
+		CPRouteMaskClear(cpState, ROUTE_MASK(ROUTE_MAIN2_EASTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN2_WESTBOUND));
+	}
+	
+
+	// Now, unlock appropriate turnouts if no routes are set and there's no occupancy
+	if (!(occupancyMain1 || occupancyMain2) && CPRouteNoneSet(cpState))
+	{
+		CPTurnoutLockSet(cpState, TURNOUT_E_XOVER, false);
+		CPTurnoutLockSet(cpState, TURNOUT_W_XOVER, false);
+	}
+}
+
+static void hostVitalAspectsReference(CPState_t *cpState, SignalHeadAspect_t* aspects)
+{
+	uint8_t i;
+
+	bool eastCrossover = CPTurnoutActualDirectionGet(cpState, TURNOUT_E_XOVER);
+	bool westCrossover = CPTurnoutActualDirectionGet(cpState, TURNOUT_W_XOVER);
+	bool m1m3Switch = CPTurnoutActualDirectionGet(cpState, TURNOUT_M1_M3);
+
+	// Start out with a safe default - everybody red
+	for(i=0; i<SIG_END; i++)
+		aspects[i] = ASPECT_RED;
+
+	if (CPTurnoutRequestedDirectionGet(cpState, TURNOUT_E_XOVER) != CPTurnoutActualDirectionGet(cpState, TURNOUT_E_XOVER)
+		|| CPTurnoutRequestedDirectionGet(cpState, TURNOUT_M1_M3) != CPTurnoutActualDirectionGet(cpState, TURNOUT_M1_M3)
+		|| CPTurnoutRequestedDirectionGet(cpState, TURNOUT_W_XOVER) != CPTurnoutActualDirectionGet(cpState, TURNOUT_W_XOVER))
+	{
+		// Turnouts are in motion - RED!
+	}
+	else if (STATE_LOCKED != CPTimelockStateGet(cpState, MAIN_TIMELOCK))
+	{
+		// Timelock isn't locked - RED!
+		if (STATE_UNLOCKED == CPTimelockStateGet(cpState, MAIN_TIMELOCK))
+		{
+			// If we're actually unlocked, put up restricting indications where appropriate
+			if (eastCrossover && westCrossover) // Both normal
+			{
+				aspects[SIG_MAIN2_W_UPPER] = ASPECT_FL_RED;
+				aspects[SIG_MAIN2_E_UPPER] = ASPECT_FL_RED;
+
+				if (m1m3Switch)
+				{
+					// M1-M3 is normal  (against M3)
+					aspects[SIG_MAIN1_W_UPPER] = ASPECT_FL_RED;
+					aspects[SIG_MAIN1_E_UPPER] = ASPECT_FL_RED;
+				} else {
+					// M1-M3 is reversed (to M3)
+					aspects[SIG_MAIN3_W_UPPER] = ASPECT_FL_RED;
+					aspects[SIG_MAIN1_E_LOWER] = ASPECT_FL_RED;
+				}
+			}
+			else if (eastCrossover && !westCrossover)
+			{
+				aspects[SIG_MAIN1_E_LOWER] = ASPECT_FL_RED;
+				aspects[SIG_MAIN2_W_LOWER] = ASPECT_FL_RED;
+			}
+			else if (!eastCrossover && westCrossover)
+			{
+				aspects[SIG_MAIN2_E_LOWER] = ASPECT_FL_RED;
+				if (m1m3Switch)
+				{
+					// M1-M3 is normal  (against M3)
+					aspects[SIG_MAIN1_W_LOWER] = ASPECT_FL_RED;
+				} else {
+					aspects[SIG_MAIN3_W_LOWER] = ASPECT_FL_RED;
+				}
+			} else {
+				aspects[SIG_MAIN2_W_LOWER] = ASPECT_FL_RED;
+				aspects[SIG_MAIN2_E_LOWER] = ASPECT_FL_RED;
+			}
+		}
+	}
+	else
+	{
+		// Work through all routes set, setting signals appropriate to state
+		if (CPRouteTest(cpState, ROUTE_MAIN1_EASTBOUND))
+		{
+			aspects[SIG_MAIN1_W_LOWER] = ASPECT_RED;
+			if (CPInputStateGet(cpState, VOCC_M1E_ADJOIN))
+			{
+				aspects[SIG_MAIN1_W_UPPER] = ASPECT_RED;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M1E_APPROACH))
+			{
+				aspects[SIG_MAIN1_W_UPPER] = ASPECT_YELLOW;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M1E_APPROACH2))
+			{
+				aspects[SIG_MAIN1_W_UPPER] = ASPECT_FL_YELLOW;
+			} else {
+				aspects[SIG_MAIN1_W_UPPER] = ASPECT_GREEN;
+			}
+		}
+		else if (CPRouteTest(cpState, ROUTE_MAIN1_WESTBOUND))
+		{
+			aspects[SIG_MAIN1_E_LOWER] = ASPECT_RED;
+			if (CPInputStateGet(cpState, VOCC_M1W_ADJOIN))
+			{
+				aspects[SIG_MAIN1_E_UPPER] = ASPECT_RED;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M1W_APPROACH))
+			{
+				aspects[SIG_MAIN1_E_UPPER] = ASPECT_YELLOW;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M1W_APPROACH2))
+			{
+				aspects[SIG_MAIN1_E_UPPER] = ASPECT_FL_YELLOW;
+			} else {
+				aspects[SIG_MAIN1_E_UPPER] = ASPECT_GREEN;
+			}
+		}
+		else if (CPRouteTest(cpState, ROUTE_MAIN1_TO_MAIN3_WESTBOUND))
+		{
+			aspects[SIG_MAIN1_E_UPPER] = ASPECT_RED;
+			if (CPInputStateGet(cpState, VOCC_M3W_ADJOIN))
+			{
+				aspects[SIG_MAIN1_E_LOWER] = ASPECT_RED;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M3W_APPROACH))
+			{
+				aspects[SIG_MAIN1_E_LOWER] = ASPECT_YELLOW;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M3W_APPROACH2))
+			{
+				aspects[SIG_MAIN1_E_LOWER] = ASPECT_FL_YELLOW;
+			} else {
+				aspects[SIG_MAIN1_E_LOWER] = ASPECT_GREEN;
+			}
+		}
+		else if (CPRouteTest(cpState, ROUTE_MAIN3_TO_MAIN1_EASTBOUND))
+		{
+			aspects[SIG_MAIN3_W_LOWER] = ASPECT_RED;
+			if (CPInputStateGet(cpState, VOCC_M1E_ADJOIN))
+			{
+				aspects[SIG_MAIN3_W_UPPER] = ASPECT_RED;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M1E_APPROACH))
+			{
+				aspects[SIG_MAIN3_W_UPPER] = ASPECT_YELLOW;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M1E_APPROACH2))
+			{
+				aspects[SIG_MAIN3_W_UPPER] = ASPECT_FL_YELLOW;
+			} else {
+				aspects[SIG_MAIN3_W_UPPER] = ASPECT_GREEN;
+			}
+		}
+
+
+		if (CPRouteTest(cpState, ROUTE_MAIN2_EASTBOUND))
+		{
+			aspects[SIG_MAIN2_W_LOWER] = ASPECT_RED;
+			if (CPInputStateGet(cpState, VOCC_M2E_ADJOIN))
+			{
+				aspects[SIG_MAIN2_W_UPPER] = ASPECT_RED;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH))
+			{
+				aspects[SIG_MAIN2_W_UPPER] = ASPECT_YELLOW;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH2))
+			{
+				aspects[SIG_MAIN2_W_UPPER] = ASPECT_FL_YELLOW;
+			} else {
+				aspects[SIG_MAIN2_W_UPPER] = ASPECT_GREEN;
+			}
+		} 
+		else if (CPRouteTest(cpState, ROUTE_MAIN2_WESTBOUND))
+		{
+			aspects[SIG_MAIN2_E_LOWER] = ASPECT_RED;
+			if (CPInputStateGet(cpState, VOCC_M2W_ADJOIN))
+			{
+				aspects[SIG_MAIN2_E_UPPER] = ASPECT_RED;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M2W_APPROACH))
+			{
+				aspects[SIG_MAIN2_E_UPPER] = ASPECT_YELLOW;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M2W_APPROACH2))
+			{
+				aspects[SIG_MAIN2_E_UPPER] = ASPECT_FL_YELLOW;
+			} else {
+				aspects[SIG_MAIN2_E_UPPER] = ASPECT_GREEN;
+			}
+		}
+		else if (CPRouteTest(cpState, ROUTE_MAIN2_VIA_MAIN1_EASTBOUND))
+		{
+			aspects[SIG_MAIN2_W_UPPER] = ASPECT_RED;
+			if (CPInputStateGet(cpState, VOCC_M2E_ADJOIN))
+			{
+				aspects[SIG_MAIN2_W_LOWER] = ASPECT_RED;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH))
+			{
+				aspects[SIG_MAIN2_W_LOWER] = ASPECT_YELLOW;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH2))
+			{
+				aspects[SIG_MAIN2_W_LOWER] = ASPECT_FL_YELLOW;
+			} else {
+				aspects[SIG_MAIN2_W_LOWER] = ASPECT_GREEN;
+			}
+		}
+		else if (CPRouteTest(cpState, ROUTE_MAIN2_VIA_MAIN1_WESTBOUND))
+		{
+			aspects[SIG_MAIN2_E_UPPER] = ASPECT_RED;
+			if (CPInputStateGet(cpState, VOCC_M2W_ADJOIN))
+			{
+				aspects[SIG_MAIN2_E_LOWER] = ASPECT_RED;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M2W_APPROACH))
+			{
+				aspects[SIG_MAIN2_E_LOWER] = ASPECT_YELLOW;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M2W_APPROACH2))
+			{
+				aspects[SIG_MAIN2_E_LOWER] = ASPECT_FL_YELLOW;
+			} else {
+				aspects[SIG_MAIN2_E_LOWER] = ASPECT_GREEN;
+			}
+		}
+		
+		// Work through all routes set, setting signals appropriate to state
+		if (CPRouteTest(cpState, ROUTE_MAIN1_TO_MAIN2_EASTBOUND))
+		{
+			aspects[SIG_MAIN1_W_UPPER] = ASPECT_RED;
+			if (CPInputStateGet(cpState, VOCC_M2E_ADJOIN))
+			{
+				aspects[SIG_MAIN1_W_LOWER] = ASPECT_RED;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH))
+			{
+				aspects[SIG_MAIN1_W_LOWER] = ASPECT_YELLOW;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH2))
+			{
+				aspects[SIG_MAIN1_W_LOWER] = ASPECT_FL_YELLOW;
+			} else {
+				aspects[SIG_MAIN1_W_LOWER] = ASPECT_GREEN;
+			}
+		}
+		else if (CPRouteTest(cpState, ROUTE_MAIN1_TO_MAIN2_WESTBOUND))
+		{
+			aspects[SIG_MAIN1_E_UPPER] = ASPECT_RED;
+			if (CPInputStateGet(cpState, VOCC_M2W_ADJOIN))
+			{
+				aspects[SIG_MAIN1_E_LOWER] = ASPECT_RED;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M2W_APPROACH))
+			{
+				aspects[SIG_MAIN1_E_LOWER] = ASPECT_YELLOW;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M2W_APPROACH2))
+			{
+				aspects[SIG_MAIN1_E_LOWER] = ASPECT_FL_YELLOW;
+			} else {
+				aspects[SIG_MAIN1_E_LOWER] = ASPECT_GREEN;
+			}
+		}
+		else if (CPRouteTest(cpState, ROUTE_MAIN2_TO_MAIN1_EASTBOUND))
+		{
+			aspects[SIG_MAIN2_W_UPPER] = ASPECT_RED;
+			if (CPInputStateGet(cpState, VOCC_M1E_ADJOIN))
+			{
+				aspects[SIG_MAIN2_W_LOWER] = ASPECT_RED;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M1E_APPROACH))
+			{
+				aspects[SIG_MAIN2_W_LOWER] = ASPECT_YELLOW;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M1E_APPROACH2))
+			{
+				aspects[SIG_MAIN2_W_LOWER] = ASPECT_FL_YELLOW;
+			} else {
+				aspects[SIG_MAIN2_W_LOWER] = ASPECT_GREEN;
+			}
+		}
+		else if (CPRouteTest(cpState, ROUTE_MAIN2_TO_MAIN3_WESTBOUND))
+		{
+			aspects[SIG_MAIN2_E_UPPER] = ASPECT_RED;
+			if (CPInputStateGet(cpState, VOCC_M3W_ADJOIN))
+			{
+				aspects[SIG_MAIN2_E_LOWER] = ASPECT_RED;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M3W_APPROACH))
+			{
+				aspects[SIG_MAIN2_E_LOWER] = ASPECT_YELLOW;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M3W_APPROACH2))
+			{
+				aspects[SIG_MAIN2_E_LOWER] = ASPECT_FL_YELLOW;
+			} else {
+				aspects[SIG_MAIN2_E_LOWER] = ASPECT_GREEN;
+			}
+		}
+		else if (CPRouteTest(cpState, ROUTE_MAIN3_TO_MAIN2_EASTBOUND))
+		{
+			aspects[SIG_MAIN3_W_UPPER] = ASPECT_RED;
+			if (CPInputStateGet(cpState, VOCC_M2E_ADJOIN))
+			{
+				aspects[SIG_MAIN3_W_LOWER] = ASPECT_RED;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH))
+			{
+				aspects[SIG_MAIN3_W_LOWER] = ASPECT_YELLOW;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH2))
+			{
+				aspects[SIG_MAIN3_W_LOWER] = ASPECT_FL_YELLOW;
+			} else {
+				aspects[SIG_MAIN3_W_LOWER] = ASPECT_GREEN;
+			}
+		}
+		else if (CPRouteTest(cpState, ROUTE_MAIN2_TO_MAIN1_WESTBOUND))
+		{
+			aspects[SIG_MAIN2_E_UPPER] = ASPECT_RED;
+			if (CPInputStateGet(cpState, VOCC_M1W_ADJOIN))
+			{
+				aspects[SIG_MAIN2_E_LOWER] = ASPECT_RED;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M1W_APPROACH))
+			{
+				aspects[SIG_MAIN2_E_LOWER] = ASPECT_YELLOW;
+			}
+			else if (CPInputStateGet(cpState, VOCC_M1W_APPROACH2))
+			{
+				aspects[SIG_MAIN2_E_LOWER] = ASPECT_FL_YELLOW;
+			} else {
+				aspects[SIG_MAIN2_E_LOWER] = ASPECT_GREEN;
+			}
+		}
+	}
+}
+
+static bool hostClearRouteReference(CPState_t* cpState, CPRouteEntrance_t entrance)
+{
+	switch(entrance)
+	{
+		case ROUTE_ENTR_M1_EASTBOUND:
+			CPRouteClear(cpState, ROUTE_MAIN1_TO_MAIN2_EASTBOUND);
+			CPRouteClear(cpState, ROUTE_MAIN1_EASTBOUND);
+			break;
+
+		case ROUTE_ENTR_M1_WESTBOUND:
+			CPRouteClear(cpState, ROUTE_MAIN1_WESTBOUND);
+			CPRouteClear(cpState, ROUTE_MAIN1_TO_MAIN2_WESTBOUND);
+			CPRouteClear(cpState, ROUTE_MAIN1_TO_MAIN3_WESTBOUND);
+			break;
+
+		case ROUTE_ENTR_M2_EASTBOUND:
+			CPRouteClear(cpState, ROUTE_MAIN2_VIA_MAIN1_EASTBOUND);
+			CPRouteClear(cpState, ROUTE_MAIN2_TO_MAIN1_EASTBOUND);
+			CPRouteClear(cpState, ROUTE_MAIN2_EASTBOUND);
+			break;
+
+		case ROUTE_ENTR_M2_WESTBOUND:
+			CPRouteClear(cpState, ROUTE_MAIN2_VIA_MAIN1_WESTBOUND);
+			CPRouteClear(cpState, ROUTE_MAIN2_TO_MAIN1_WESTBOUND);
+			CPRouteClear(cpState, ROUTE_MAIN2_TO_MAIN3_WESTBOUND);
+			CPRouteClear(cpState, ROUTE_MAIN2_WESTBOUND);
+			break;
+		
+		case ROUTE_ENTR_M3_EASTBOUND:
+			CPRouteClear(cpState, ROUTE_MAIN3_TO_MAIN1_EASTBOUND);
+			CPRouteClear(cpState, ROUTE_MAIN3_TO_MAIN2_EASTBOUND);
+			break;
+
+		default:
+			return false;
+	}
+
+	return true;
+}
+
+static bool hostCodeRouteReference(CPState_t* cpState, CPRouteEntrance_t entrance, bool setRoute)
+{
+	if (STATE_LOCKED != CPTimelockStateGet(cpState, MAIN_TIMELOCK))
+		return false; // Can't set any route when the timelock is open
+
+	if (false == setRoute)
+		return hostClearRouteReference(cpState, entrance);
+
+	bool eastCrossover = CPTurnoutRequestedDirectionGet(cpState, TURNOUT_E_XOVER);
+	bool westCrossover = CPTurnoutRequestedDirectionGet(cpState, TURNOUT_W_XOVER);
+	bool m1m3Switch = CPTurnoutRequestedDirectionGet(cpState, TURNOUT_M1_M3);
+	
+	// Remember, with turnouts normal = true
+
+	switch(entrance)
+	{
+		case ROUTE_ENTR_M3_EASTBOUND:
+			if (!westCrossover || m1m3Switch) // Turnout set against us
+				return false;
+				
+			if (eastCrossover)
+			{
+				// Both crossovers normal, straight through route
+				// Is there already a conflicting route set?
+				if (CPRouteAnySet(cpState, ROUTE_CONFLICTS_MAIN3_TO_MAIN1_EASTBOUND))
+					return false;
+
+				// Lock turnouts
+				hostLockAllTurnoutsReference(cpState);
+				// Set route
+				CPRouteSet(cpState, ROUTE_MAIN3_TO_MAIN1_EASTBOUND);
+			} else {
+				// West crossover reversed, M1->M2
+				if (CPRouteAnySet(cpState, ROUTE_CONFLICTS_MAIN3_TO_MAIN2_EASTBOUND)) 
+					return false;
+
+				// Lock turnouts
+				hostLockAllTurnoutsReference(cpState);
+				CPRouteSet(cpState, ROUTE_MAIN3_TO_MAIN2_EASTBOUND);
+			}
+			break;
+		
+		case ROUTE_ENTR_M1_EASTBOUND:
+			if (!westCrossover || !m1m3Switch) // Turnout set against us
+				return false;
+
+			if (eastCrossover)
+			{
+				// Both crossovers normal, straight through route
+				// Is there already a conflicting route set?
+				if (CPRouteAnySet(cpState, ROUTE_CONFLICTS_MAIN1_EASTBOUND))
+					return false;
+
+				// Lock turnouts
+				hostLockAllTurnoutsReference(cpState);
+				// Set route
+				CPRouteSet(cpState, ROUTE_MAIN1_EASTBOUND);
+			} else {
+				// West crossover reversed, M1->M2
+				if (CPRouteAnySet(cpState, ROUTE_CONFLICTS_MAIN1_TO_MAIN2_EASTBOUND))
+					return false;
+
+				// Lock turnouts
+				hostLockAllTurnoutsReference(cpState);
+				CPRouteSet(cpState, ROUTE_MAIN1_TO_MAIN2_EASTBOUND);
+			}
+			break;
+			
+			
+		case ROUTE_ENTR_M1_WESTBOUND:
+			if (!eastCrossover) // Turnout set against us
+				return false;
+				
+			if (westCrossover)
+			{
+				// Both crossovers normal, straight through route
+
+				if (m1m3Switch)
+				{
+					// Is there already a conflicting route set?
+					if (CPRouteAnySet(cpState, ROUTE_CONFLICTS_MAIN1_WESTBOUND))
+						return false;
+
+					// Lock turnouts
+					hostLockAllTurnoutsReference(cpState);
+					// Set route
+					CPRouteSet(cpState, ROUTE_MAIN1_WESTBOUND);
+				} else {
+					// M1 to M3 switch is reversed
+					// Is there already a conflicting route set?
+					if (CPRouteAnySet(cpState, ROUTE_CONFLICTS_MAIN1_TO_MAIN3_WESTBOUND))
+						return false;
+					// Lock turnouts
+					hostLockAllTurnoutsReference(cpState);
+					// Set route
+					CPRouteSet(cpState, ROUTE_MAIN1_TO_MAIN3_WESTBOUND);
+				}
+			} else {
+				// West crossover reversed, M1->M2
+				if (CPRouteAnySet(cpState, ROUTE_CONFLICTS_MAIN1_TO_MAIN2_WESTBOUND))
+					return false;
+
+				CPRouteSet(cpState, ROUTE_MAIN1_TO_MAIN2_WESTBOUND);
+			}
+			break;
+		
+		case ROUTE_ENTR_M2_EASTBOUND:
+			if (!eastCrossover && !westCrossover)
+			{
+				// Main 2 -> Main 2 via Main 1 - icky
+				if (CPRouteAnySet(cpState, ROUTE_CONFLICTS_MAIN2_VIA_MAIN1_EASTBOUND))
+					return false;
+
+				hostLockAllTurnoutsReference(cpState);
+				CPRouteSet(cpState, ROUTE_MAIN2_VIA_MAIN1_EASTBOUND);
+				
+			} else if (eastCrossover && westCrossover) {
+				// Both crossovers normal, straight through route
+				// Is there already a conflicting route set?
+				if (CPRouteAnySet(cpState, ROUTE_CONFLICTS_MAIN2_EASTBOUND))
+					return false;
+
+				// Set route
+				hostLockAllTurnoutsReference(cpState);
+				CPRouteSet(cpState, ROUTE_MAIN2_EASTBOUND);
+				return true;
+			} else if (!westCrossover && eastCrossover) {
+				// West crossover reversed, M2->M1
+				if (CPRouteAnySet(cpState, ROUTE_CONFLICTS_MAIN2_TO_MAIN1_EASTBOUND))
+					return false;
+
+				hostLockAllTurnoutsReference(cpState);
+				CPRouteSet(cpState, ROUTE_MAIN2_TO_MAIN1_EASTBOUND);
+				return true;
+			} else {
+				return false;
+			}
+			break;
+			
+			
+		case ROUTE_ENTR_M2_WESTBOUND:
+			if (!eastCrossover && !westCrossover)
+			{
+				// Main 2 -> Main 2 via Main 1 - icky
+				if (CPRouteAnySet(cpState, ROUTE_CONFLICTS_MAIN2_VIA_MAIN1_WESTBOUND))
+					return false;
+					
+				hostLockAllTurnoutsReference(cpState);
+				CPRouteSet(cpState, ROUTE_MAIN2_VIA_MAIN1_WESTBOUND);
+				return true;
+			} else if (eastCrossover && westCrossover) {
+				// Both crossovers normal, straight through route
+				// Is there already a conflicting route set?
+				if (CPRouteAnySet(cpState, ROUTE_CONFLICTS_MAIN2_WESTBOUND))
+					return false;
+
+				// Set route
+				hostLockAllTurnoutsReference(cpState);
+				CPRouteSet(cpState, ROUTE_MAIN2_WESTBOUND);
+				return true;
+			} else if (westCrossover && !eastCrossover) {
+
+				if (m1m3Switch)
+				{
+					// West crossover reversed, M2->M1
+					if (CPRouteAnySet(cpState, ROUTE_CONFLICTS_MAIN2_TO_MAIN1_WESTBOUND))
+						return false;
+
+					hostLockAllTurnoutsReference(cpState);
+					CPRouteSet(cpState, ROUTE_MAIN2_TO_MAIN1_WESTBOUND);
+				} else {
+					if (CPRouteAnySet(cpState, ROUTE_CONFLICTS_MAIN2_TO_MAIN3_WESTBOUND))
+						return false;
+
+					hostLockAllTurnoutsReference(cpState);
+					CPRouteSet(cpState, ROUTE_MAIN2_TO_MAIN3_WESTBOUND);
+				}
+				return true;
+			} else {
+				return false;
+			}
+			break;
+			
+		default:
+			break;
+	}
+	
+	return false;
+}
+
+#endif
@@ -0,0 +1,1163 @@
+/*************************************************************************
+Title:    MRB-XO3 Host Harness
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     host/xo3-host.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+// Runs the unmodified control point firmware as a Linux process.
+//
+// The firmware's main() is renamed and driven from here: every watchdog
+// kick is one main loop pass, and every HOST_PASSES_PER_TICK passes the
+// 100Hz timer interrupt fires and the scripted scenario below gets a
+// chance to inject MRBus packets or move XIO input pins.  Two simulated
+// XIOs sit on the I2C bus and turnout machines follow their control
+// outputs, feeding position back to the inputs.
+//
+// Usage:
+//   mrb-xo3-host         - run the scenario, log bus traffic to stdout
+//   mrb-xo3-host bench   - time the individual logic stages
+//   mrb-xo3-host verify  - check the route and aspect tables against the
+//                          original hand-written logic, then run the
+//                          focused checks (repeat cache, expedite,
+//                          debounce) - exits nonzero on any mismatch
+//   mrb-xo3-host tables  - regenerate the aspect tables in config-aspects.h
+//                          from the original logic
+//
+// The stdout log is deterministic, so diffing it across changes checks
+// that a performance change didn't change behaviour.  Timing and bus
+// statistics go to stderr.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <time.h>
+
+#include "host-harness.h"
+
+// Pull in the firmware itself so the harness can reach its static pieces
+#define main xo3FirmwareMain
+#include "../mrb-xo3.c"
+#undef main
+
+#include "vital-reference.h"
+
+#define HOST_PASSES_PER_TICK   64
+#define HOST_TURNOUT_TICKS     30
+// Timer1 counts at F_CPU/8 - 25000 counts per 10ms tick, spread across its passes
+#define HOST_TIMER1_COUNTS_PER_TICK  (F_CPU / 8 / 100)
+
+bool hostMRBusInitialized = false;
+
+static jmp_buf hostExit;
+static uint32_t hostTick = 0;
+static uint32_t hostPasses = 0;
+static uint8_t hostPassesThisTick = 0;
+static uint32_t hostSleeps = 0;
+static uint32_t hostTimer1Time = 0;
+static uint8_t hostLastOutputs[HOST_XIO_MAX][5];
+static bool hostLogging = true;
+
+typedef enum
+{
+	STIM_PACKET,
+	STIM_INPUT,
+	STIM_END
+} HostStimulusType_t;
+
+typedef struct
+{
+	uint32_t tick;
+	HostStimulusType_t type;
+	uint8_t data[MRBUS_BUFFER_SIZE];
+} HostStimulus;
+
+// Node addresses used by the scenario
+#define HOST_CP_ADDR     0x03
+#define HOST_EAST_ADDR   0x20
+#define HOST_WEST_ADDR   0x30
+#define HOST_OS_ADDR     0x40
+#define HOST_OTHER_ADDR  0x50
+
+// STIM_PACKET data is dest, src, len, then the payload starting at the type
+// byte - the harness fills in the CRC.  STIM_INPUT data is xio, port, bit, level.
+static const HostStimulus hostScenario[] =
+{
+	{  100, STIM_PACKET, { 0xFF, HOST_EAST_ADDR, 8, 'S', 0x00, 0x00 } },
+	{  100, STIM_PACKET, { 0xFF, HOST_WEST_ADDR, 8, 'S', 0x00, 0x00 } },
+	{  100, STIM_PACKET, { 0xFF, HOST_OS_ADDR, 7, 'S', 0x00 } },
+	{  120, STIM_PACKET, { 0xFF, HOST_OTHER_ADDR, 10, 'S', 0x12, 0x34, 0x56, 0x78 } },
+	{  150, STIM_PACKET, { HOST_CP_ADDR, 0xFE, 9, 'C', 'G', ROUTE_ENTR_M1_WESTBOUND, 'S' } },
+	{  200, STIM_PACKET, { 0xFF, HOST_WEST_ADDR, 8, 'S', 0x02, 0x00 } },
+	{  250, STIM_PACKET, { 0xFF, HOST_WEST_ADDR, 8, 'S', 0x04, 0x00 } },
+	{  300, STIM_PACKET, { 0xFF, HOST_OS_ADDR, 7, 'S', 0x01 } },
+	{  350, STIM_PACKET, { 0xFF, HOST_OS_ADDR, 7, 'S', 0x00 } },
+	{  400, STIM_PACKET, { HOST_CP_ADDR, 0xFE, 9, 'C', 'T', TURNOUT_E_XOVER, 'D' } },
+	{  500, STIM_PACKET, { HOST_CP_ADDR, 0xFE, 9, 'C', 'G', ROUTE_ENTR_M2_WESTBOUND, 'S' } },
+	{  550, STIM_PACKET, { 0xFF, HOST_WEST_ADDR, 8, 'S', 0x00, 0x00 } },
+	{  600, STIM_PACKET, { HOST_CP_ADDR, 0xFE, 9, 'C', 'G', ROUTE_ENTR_M2_WESTBOUND, 'C' } },
+	{  650, STIM_PACKET, { HOST_CP_ADDR, 0xFE, 9, 'C', 'T', TURNOUT_E_XOVER, 'M' } },
+	{  700, STIM_PACKET, { HOST_CP_ADDR, 0xFE, 9, 'C', 'T', TURNOUT_M1_M3, 'D' } },
+	{  800, STIM_PACKET, { HOST_CP_ADDR, 0xFE, 9, 'C', 'G', ROUTE_ENTR_M3_EASTBOUND, 'S' } },
+	{  850, STIM_PACKET, { 0xFF, HOST_EAST_ADDR, 8, 'S', 0x01, 0x00 } },
+	{  900, STIM_PACKET, { HOST_CP_ADDR, 0xFE, 9, 'C', 'G', ROUTE_ENTR_M3_EASTBOUND, 'C' } },
+	{  910, STIM_PACKET, { HOST_CP_ADDR, 0xFE, 9, 'C', 'T', TURNOUT_M1_M3, 'M' } },
+	{  920, STIM_PACKET, { 0xFF, HOST_EAST_ADDR, 8, 'S', 0x00, 0x00 } },
+	{  950, STIM_INPUT,  { 0, XIO_PORT_D, 7, 0 } },   // Timelock switch to unlock
+	{ 1300, STIM_INPUT,  { 1, XIO_PORT_A, 4, 0 } },   // West crossover manual reverse
+	{ 1400, STIM_INPUT,  { 1, XIO_PORT_A, 4, 1 } },   // West crossover manual normal
+	{ 1450, STIM_INPUT,  { 0, XIO_PORT_D, 7, 1 } },   // Timelock switch to lock
+	{ 1500, STIM_PACKET, { HOST_CP_ADDR, 0xFE, 9, 'C', 'G', ROUTE_ENTR_M1_EASTBOUND, 'S' } },
+	{ 1500, STIM_PACKET, { HOST_CP_ADDR, 0xFE, 9, 'C', 'G', ROUTE_ENTR_M2_WESTBOUND, 'S' } },
+	{ 1550, STIM_PACKET, { 0xFF, HOST_OS_ADDR, 7, 'S', 0x02 } },
+	{ 1600, STIM_PACKET, { 0xFF, HOST_OS_ADDR, 7, 'S', 0x00 } },
+	{ 1600, STIM_PACKET, { HOST_CP_ADDR, 0xFE, 6, 'A' } },
+	{ 1610, STIM_PACKET, { HOST_CP_ADDR, 0xFE, 6, 'V' } },
+	{ 1620, STIM_PACKET, { HOST_CP_ADDR, 0xFE, 7, 'R', EE_UNLOCK_TIME } },
+	{ 1630, STIM_PACKET, { 0x07, 0xFE, 7, 'R', EE_UNLOCK_TIME } },
+	{ 1650, STIM_PACKET, { HOST_CP_ADDR, 0xFE, 8, 'W', EE_M1E_APRCH_PKT, 'T' } },
+	{ 1700, STIM_PACKET, { 0xFF, HOST_EAST_ADDR, 8, 'S', 0x02, 0x00 } },
+	{ 1720, STIM_PACKET, { 0xFF, HOST_EAST_ADDR, 8, 'S', 0x02, 0x00 } },  // Same status again - skipped by the repeat cache
+	{ 1750, STIM_PACKET, { 0xFF, HOST_EAST_ADDR, 7, 'T', 0x02 } },
+	{ 1800, STIM_END },
+};
+
+static const HostStimulus* hostNextStimulus = hostScenario;
+
+typedef struct
+{
+	uint8_t xioNum;
+	uint8_t controlPort, controlBit;
+	uint8_t feedbackPort, feedbackBit;
+	bool feedback;
+	uint8_t countdown;
+} HostTurnoutMachine;
+
+// Control outputs are high for normal, feedback inputs are high for reverse
+static HostTurnoutMachine hostTurnouts[] =
+{
+	{ 1, XIO_PORT_A, 0, XIO_PORT_A, 6, false, HOST_TURNOUT_TICKS },
+	{ 1, XIO_PORT_A, 1, XIO_PORT_A, 7, false, HOST_TURNOUT_TICKS },
+	{ 1, XIO_PORT_A, 2, XIO_PORT_B, 0, false, HOST_TURNOUT_TICKS },
+};
+
+static void hostEepromSetVInput(uint8_t eeAddr, uint8_t eePkt, uint8_t eeBitByte, uint8_t src, uint8_t type, uint8_t byteNum, uint8_t bitNum)
+{
+	hostEeprom[eeAddr] = src;
+	hostEeprom[eePkt] = type;
+	hostEeprom[eeBitByte] = (bitNum << 5) | byteNum;
+}
+
+static void hostEepromSetup(void)
+{
+	memset(hostEeprom, 0xFF, sizeof(hostEeprom));
+	hostEeprom[MRBUS_EE_DEVICE_ADDR] = HOST_CP_ADDR;
+	hostEeprom[MRBUS_EE_DEVICE_UPDATE_H] = 0x00;
+	hostEeprom[MRBUS_EE_DEVICE_UPDATE_L] = 20;
+	hostEeprom[EE_UNLOCK_TIME] = 30;
+
+	hostEepromSetVInput(EE_M1E_ADJ_ADDR,    EE_M1E_ADJ_PKT,    EE_M1E_ADJ_BITBYTE,    HOST_EAST_ADDR, 'S', 6, 0);
+	hostEepromSetVInput(EE_M1E_APRCH_ADDR,  EE_M1E_APRCH_PKT,  EE_M1E_APRCH_BITBYTE,  HOST_EAST_ADDR, 'S', 6, 1);
+	hostEepromSetVInput(EE_M1E_APRCH2_ADDR, EE_M1E_APRCH2_PKT, EE_M1E_APRCH2_BITBYTE, HOST_EAST_ADDR, 'S', 6, 2);
+	hostEepromSetVInput(EE_M1E_TUMBLE_ADDR, EE_M1E_TUMBLE_PKT, EE_M1E_TUMBLE_BITBYTE, HOST_EAST_ADDR, 'S', 6, 3);
+	hostEepromSetVInput(EE_M2E_ADJ_ADDR,    EE_M2E_ADJ_PKT,    EE_M2E_ADJ_BITBYTE,    HOST_EAST_ADDR, 'S', 6, 4);
+	hostEepromSetVInput(EE_M2E_APRCH_ADDR,  EE_M2E_APRCH_PKT,  EE_M2E_APRCH_BITBYTE,  HOST_EAST_ADDR, 'S', 6, 5);
+	hostEepromSetVInput(EE_M2E_APRCH2_ADDR, EE_M2E_APRCH2_PKT, EE_M2E_APRCH2_BITBYTE, HOST_EAST_ADDR, 'S', 6, 6);
+	hostEepromSetVInput(EE_M2E_TUMBLE_ADDR, EE_M2E_TUMBLE_PKT, EE_M2E_TUMBLE_BITBYTE, HOST_EAST_ADDR, 'S', 6, 7);
+
+	hostEepromSetVInput(EE_M1W_ADJ_ADDR,    EE_M1W_ADJ_PKT,    EE_M1W_ADJ_BITBYTE,    HOST_WEST_ADDR, 'S', 6, 0);
+	hostEepromSetVInput(EE_M1W_APRCH_ADDR,  EE_M1W_APRCH_PKT,  EE_M1W_APRCH_BITBYTE,  HOST_WEST_ADDR, 'S', 6, 1);
+	hostEepromSetVInput(EE_M1W_APRCH2_ADDR, EE_M1W_APRCH2_PKT, EE_M1W_APRCH2_BITBYTE, HOST_WEST_ADDR, 'S', 6, 2);
+	hostEepromSetVInput(EE_M1W_TUMBLE_ADDR, EE_M1W_TUMBLE_PKT, EE_M1W_TUMBLE_BITBYTE, HOST_WEST_ADDR, 'S', 6, 3);
+	hostEepromSetVInput(EE_M2W_ADJ_ADDR,    EE_M2W_ADJ_PKT,    EE_M2W_ADJ_BITBYTE,    HOST_WEST_ADDR, 'S', 6, 4);
+	hostEepromSetVInput(EE_M2W_APRCH_ADDR,  EE_M2W_APRCH_PKT,  EE_M2W_APRCH_BITBYTE,  HOST_WEST_ADDR, 'S', 6, 5);
+	hostEepromSetVInput(EE_M2W_APRCH2_ADDR, EE_M2W_APRCH2_PKT, EE_M2W_APRCH2_BITBYTE, HOST_WEST_ADDR, 'S', 6, 6);
+	hostEepromSetVInput(EE_M2W_TUMBLE_ADDR, EE_M2W_TUMBLE_PKT, EE_M2W_TUMBLE_BITBYTE, HOST_WEST_ADDR, 'S', 6, 7);
+	hostEepromSetVInput(EE_M3W_ADJ_ADDR,    EE_M3W_ADJ_PKT,    EE_M3W_ADJ_BITBYTE,    HOST_WEST_ADDR, 'S', 7, 0);
+	hostEepromSetVInput(EE_M3W_APRCH_ADDR,  EE_M3W_APRCH_PKT,  EE_M3W_APRCH_BITBYTE,  HOST_WEST_ADDR, 'S', 7, 1);
+	hostEepromSetVInput(EE_M3W_APRCH2_ADDR, EE_M3W_APRCH2_PKT, EE_M3W_APRCH2_BITBYTE, HOST_WEST_ADDR, 'S', 7, 2);
+	hostEepromSetVInput(EE_M3W_TUMBLE_ADDR, EE_M3W_TUMBLE_PKT, EE_M3W_TUMBLE_BITBYTE, HOST_WEST_ADDR, 'S', 7, 3);
+
+	hostEepromSetVInput(EE_M1_OS_ADDR,      EE_M1_OS_PKT,      EE_M1_OS_BITBYTE,      HOST_OS_ADDR,   'S', 6, 0);
+	hostEepromSetVInput(EE_M2_OS_ADDR,      EE_M2_OS_PKT,      EE_M2_OS_BITBYTE,      HOST_OS_ADDR,   'S', 6, 1);
+}
+
+static void hostXioSetup(void)
+{
+	hostXioAttach(0, I2C_XIO0_ADDRESS);
+	hostXioAttach(1, I2C_XIO1_ADDRESS);
+
+	// Timelock switch locked, manual request switches all normal
+	hostXioSetInputPin(0, XIO_PORT_D, 7, true);
+	hostXioSetInputPin(1, XIO_PORT_A, 3, true);
+	hostXioSetInputPin(1, XIO_PORT_A, 4, true);
+	hostXioSetInputPin(1, XIO_PORT_A, 5, true);
+}
+
+static void hostPrintTime(void)
+{
+	printf("%4u.%02u ", hostTick / 100, hostTick % 100);
+}
+
+void hostMRBusTransmitted(const uint8_t* pkt, uint8_t len)
+{
+	if (!hostLogging)
+		return;
+	hostPrintTime();
+	printf("TX");
+	for (uint8_t i=0; i<len; i++)
+		printf(" %02X", pkt[i]);
+	printf("\n");
+}
+
+static void hostInjectPacket(const uint8_t* data)
+{
+	uint8_t pkt[MRBUS_BUFFER_SIZE];
+	uint8_t len = data[MRBUS_PKT_LEN];
+	uint16_t crc = 0;
+
+	memset(pkt, 0, sizeof(pkt));
+	pkt[MRBUS_PKT_DEST] = data[0];
+	pkt[MRBUS_PKT_SRC] = data[1];
+	pkt[MRBUS_PKT_LEN] = len;
+	memcpy(&pkt[MRBUS_PKT_TYPE], &data[3], len - MRBUS_PKT_TYPE);
+
+	for (uint8_t i=0; i<len; i++)
+	{
+		if (i != MRBUS_PKT_CRC_H && i != MRBUS_PKT_CRC_L)
+			crc = mrbusCRC16Update(crc, pkt[i]);
+	}
+	pkt[MRBUS_PKT_CRC_L] = UINT16_LOW_BYTE(crc);
+	pkt[MRBUS_PKT_CRC_H] = UINT16_HIGH_BYTE(crc);
+
+	if (!mrbusPktQueuePush(&mrbusRxQueue, pkt, len))
+		fprintf(stderr, "RX queue overflow at tick %u\n", hostTick);
+}
+
+static void hostTurnoutMachines(void)
+{
+	for (uint8_t i=0; i<sizeof(hostTurnouts)/sizeof(HostTurnoutMachine); i++)
+	{
+		HostTurnoutMachine* t = &hostTurnouts[i];
+		bool target = !hostXioGetOutputPin(t->xioNum, t->controlPort, t->controlBit);
+		if (target == t->feedback)
+			t->countdown = HOST_TURNOUT_TICKS;
+		else if (0 == --t->countdown)
+		{
+			t->feedback = target;
+			t->countdown = HOST_TURNOUT_TICKS;
+			hostXioSetInputPin(t->xioNum, t->feedbackPort, t->feedbackBit, t->feedback);
+		}
+	}
+}
+
+static void hostLogOutputs(void)
+{
+	uint8_t outputs[5];
+	for (uint8_t x=0; x<2; x++)
+	{
+		hostXioGetOutputs(x, outputs);
+		if (0 == memcmp(outputs, hostLastOutputs[x], sizeof(outputs)))
+			continue;
+		memcpy(hostLastOutputs[x], outputs, sizeof(outputs));
+		if (!hostLogging)
+			continue;
+		hostPrintTime();
+		printf("XIO%u OUT %02X %02X %02X %02X %02X\n", x, outputs[0], outputs[1], outputs[2], outputs[3], outputs[4]);
+	}
+}
+
+// Keep TCNT1 in step with simulated time so timestampGet() means something
+static void hostTimer1Sync(void)
+{
+	uint32_t now = hostTick * HOST_TIMER1_COUNTS_PER_TICK
+		+ hostPassesThisTick * (HOST_TIMER1_COUNTS_PER_TICK / HOST_PASSES_PER_TICK);
+	uint32_t elapsed = now - hostTimer1Time;
+	hostTimer1Time = now;
+
+	if (0 == (TCCR1B & (_BV(CS10) | _BV(CS11) | _BV(CS12))))
+		return;
+
+	if ((uint32_t)hostTCNT1 + elapsed > 0xFFFF)
+		TIFR1 |= _BV(TOV1);
+	hostTCNT1 += elapsed;
+	if ((TIFR1 & _BV(TOV1)) && (TIMSK1 & _BV(TOIE1)))
+	{
+		TIFR1 &= ~_BV(TOV1);
+		TIMER1_OVF_vect();
+	}
+}
+
+static void hostAdvanceTick(void)
+{
+	hostPassesThisTick = 0;
+	hostTick++;
+	hostTimer1Sync();
+
+	if (TIMSK0 & _BV(OCIE0A))
+		TIMER0_COMPA_vect();
+
+	hostLogOutputs();
+	hostTurnoutMachines();
+
+	while (hostNextStimulus->tick <= hostTick)
+	{
+		const HostStimulus* s = hostNextStimulus++;
+		switch(s->type)
+		{
+			case STIM_PACKET:
+				if (hostMRBusInitialized)
+					hostInjectPacket(s->data);
+				break;
+			case STIM_INPUT:
+				hostXioSetInputPin(s->data[0], s->data[1], s->data[2], s->data[3]);
+				break;
+			case STIM_END:
+				longjmp(hostExit, 1);
+		}
+	}
+}
+
+void hostWatchdogReset(void)
+{
+	hostPasses++;
+	hostI2CAdvance();
+	if (++hostPassesThisTick >= HOST_PASSES_PER_TICK)
+		hostAdvanceTick();
+	else
+		hostTimer1Sync();
+}
+
+void hostSleepCpu(void)
+{
+	hostSleeps++;
+	if (!hostI2CFinish())
+		hostAdvanceTick();
+}
+
+static double hostElapsedNs(const struct timespec* start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+static int hostRunScenario(void)
+{
+	struct timespec start;
+	int failed = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (0 == setjmp(hostExit))
+		xo3FirmwareMain();
+
+	double ns = hostElapsedNs(&start);
+	fprintf(stderr, "scenario: %u ticks, %u loop passes, %.0f ns/pass\n", hostTick, hostPasses, ns / hostPasses);
+	fprintf(stderr, "idle: %u sleeps, %.1f awake passes/tick\n", hostSleeps, (double)(hostPasses - hostSleeps) / hostTick);
+	fprintf(stderr, "i2c: %u transactions, %u bytes, %u busy spins, %u nacks\n",
+		hostI2CStats.transactions, hostI2CStats.bytes, hostI2CStats.busySpins, hostI2CStats.nacks);
+	fprintf(stderr, "eeprom: %u reads, %u writes\n", hostEepromReads, hostEepromWrites);
+	fprintf(stderr, "rx filter: %u queued, %u dropped, %u repeats skipped\n", rxFilterStats.accepted, rxFilterStats.dropped,
+		CPMRBusVirtInputRepeatsSkipped());
+	fprintf(stderr, "rx queue: high water %u of %u, %u overflows, most %u packets per drain, %u budget cutoffs\n",
+		rxQueueStats.highWater, rxBuffer_DEPTH, rxQueueStats.overflows, rxQueueStats.maxBatch, rxQueueStats.budgetCutoffs);
+
+	for (uint8_t c=0; c<LATENCY_END; c++)
+	{
+		const LatencyStats_t* stats = latencyStatsGet(c);
+		fprintf(stderr, "latency %-5s: %u samples, min %.1f ms, mean %.1f ms, max %.1f ms\n",
+			(LATENCY_INPUT == c) ? "input" : "ctc", stats->count,
+			stats->count ? stats->min / 10.0 : 0.0, latencyMean(stats) / 10.0, stats->max / 10.0);
+	}
+
+#ifdef CP_PROFILE
+	// Host Timer1 counts are mostly TCNT1 reads (HOST_TIMER1_COUNTS_PER_READ),
+	//  so these say more about the wiring than about where AVR time goes
+	static const char* const stageNames[PROFILE_END] = {
+		"PktHandler", "xioProcess", "CPXIOInputFilter", "cpHandleTurnouts",
+		"vitalLogic", "outputs", "cpStateToStatusPacket", "mrbusTransmit", "loop" };
+	const ProfileStats_t* loop = profileStatsGet(PROFILE_LOOP);
+	uint32_t stageSum = 0, stageCalls = 0;
+
+	for (uint8_t stage=0; stage<PROFILE_END; stage++)
+	{
+		const ProfileStats_t* stats = profileStatsGet(stage);
+		fprintf(stderr, "profile %-22s: %6u calls, %8u counts, worst %5u\n",
+			stageNames[stage], stats->count, stats->sum, stats->worst);
+		if (0 == stats->count || 0 == stats->sum)
+		{
+			fprintf(stderr, "PROFILE CHECK FAILED: %s never timed\n", stageNames[stage]);
+			failed = 1;
+		}
+		if (PROFILE_LOOP != stage)
+		{
+			stageSum += stats->sum;
+			stageCalls += stats->count;
+		}
+	}
+
+	// Everything in a pass should be inside some stage.  All that's left over
+	//  is the profiler's own reads - each stage's start, the loop's stop - and
+	//  a few timestamps taken between stages, so allow 5% for those.
+	uint32_t profilerReads = (stageCalls + loop->count) * HOST_TIMER1_COUNTS_PER_READ;
+	uint32_t accounted = stageSum + profilerReads;
+	fprintf(stderr, "profile: stages %u counts + %u for profiler reads of %u loop counts\n",
+		stageSum, profilerReads, loop->sum);
+	if (accounted > loop->sum || accounted < loop->sum - loop->sum / 20)
+	{
+		fprintf(stderr, "PROFILE CHECK FAILED: stages don't add up to the loop\n");
+		failed = 1;
+	}
+#endif
+	return failed;
+}
+
+#define HOST_BENCH_ITERATIONS 1000000UL
+
+// The per-byte CRC check PktHandler used before pktCrcValid()
+static bool hostCrcValidReference(const uint8_t* pkt)
+{
+	uint16_t crc = 0;
+	uint8_t i;
+
+	for(i=0; i<pkt[MRBUS_PKT_LEN]; i++)
+	{
+		if ((i != MRBUS_PKT_CRC_H) && (i != MRBUS_PKT_CRC_L))
+			crc = mrbusCRC16Update(crc, pkt[i]);
+	}
+	return ((UINT16_HIGH_BYTE(crc) == pkt[MRBUS_PKT_CRC_H]) && (UINT16_LOW_BYTE(crc) == pkt[MRBUS_PKT_CRC_L]));
+}
+
+static void hostCrcPacketBuild(uint8_t* pkt, uint8_t len)
+{
+	uint16_t crc;
+	uint8_t i;
+
+	for (i=0; i<MRBUS_BUFFER_SIZE; i++)
+		pkt[i] = rand() & 0xFF;
+	pkt[MRBUS_PKT_LEN] = len;
+	crc = 0;
+	for (i=0; i<len; i++)
+	{
+		if ((i != MRBUS_PKT_CRC_H) && (i != MRBUS_PKT_CRC_L))
+			crc = mrbusCRC16Update(crc, pkt[i]);
+	}
+	pkt[MRBUS_PKT_CRC_L] = UINT16_LOW_BYTE(crc);
+	pkt[MRBUS_PKT_CRC_H] = UINT16_HIGH_BYTE(crc);
+}
+
+static void hostBenchReport(const char* name, const struct timespec* start, uint32_t eeReadsStart)
+{
+	double ns = hostElapsedNs(start);
+	fprintf(stderr, "%-36s %8.1f ns/call %6.1f eeprom reads/call\n", name, ns / HOST_BENCH_ITERATIONS,
+		(double)(hostEepromReads - eeReadsStart) / HOST_BENCH_ITERATIONS);
+}
+
+static void hostRunBench(void)
+{
+	CPState_t cpState;
+	XIOControl xio[2];
+	uint8_t mrbTxBuffer[MRBUS_BUFFER_SIZE];
+	const uint8_t broadcast[] = { 0xFF, HOST_WEST_ADDR, 8, 'S', 0x02, 0x00 };
+	const uint8_t xio0PinDirection[5] = { 0x00, 0x00, 0x00, 0x80, 0x00 };
+	const uint8_t xio1PinDirection[5] = { 0xF8, 0x01, 0x00, 0x00, 0x00 };
+	struct timespec start;
+	uint32_t eeReads;
+	unsigned long i;
+
+	hostLogging = false;
+	mrbus_dev_addr = HOST_CP_ADDR;
+	mrbusPktQueueInitialize(&mrbusTxQueue, mrbusTxPktBufferArray, txBuffer_DEPTH);
+	mrbusPktQueueInitialize(&mrbusRxQueue, mrbusRxPktBufferArray, rxBuffer_DEPTH);
+	xioInitialize(&xio[0], I2C_XIO0_ADDRESS, xio0PinDirection);
+	xioInitialize(&xio[1], I2C_XIO1_ADDRESS, xio1PinDirection);
+	CPInitialize(&cpState);
+	cpCodeRoute(&cpState, ROUTE_ENTR_M1_WESTBOUND, true);
+	cpCodeRoute(&cpState, ROUTE_ENTR_M2_EASTBOUND, true);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	eeReads = hostEepromReads;
+	for (i=0; i<HOST_BENCH_ITERATIONS; i++)
+	{
+		hostInjectPacket(broadcast);
+		PktHandler(&cpState);
+		while(mrbusPktQueueDepth(&mrbusTxQueue))
+			mrbusTransmit();
+	}
+	hostBenchReport("PktHandler (broadcast)", &start, eeReads);
+	fprintf(stderr, "  %u of them skipped as repeats\n", CPMRBusVirtInputRepeatsSkipped());
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	eeReads = hostEepromReads;
+	for (i=0; i<HOST_BENCH_ITERATIONS; i++)
+	{
+		xioInputRead(&xio[0]);
+		xioInputRead(&xio[1]);
+	}
+	hostBenchReport("xioInputRead (x2)", &start, eeReads);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	eeReads = hostEepromReads;
+	for (i=0; i<HOST_BENCH_ITERATIONS; i++)
+		CPXIOInputFilter(&cpState, xio);
+	hostBenchReport("CPXIOInputFilter", &start, eeReads);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	eeReads = hostEepromReads;
+	for (i=0; i<HOST_BENCH_ITERATIONS; i++)
+		cpHandleTurnouts(&cpState, xio);
+	hostBenchReport("cpHandleTurnouts", &start, eeReads);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	eeReads = hostEepromReads;
+	for (i=0; i<HOST_BENCH_ITERATIONS; i++)
+		vitalLogic(&cpState);
+	hostBenchReport("vitalLogic", &start, eeReads);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	eeReads = hostEepromReads;
+	for (i=0; i<HOST_BENCH_ITERATIONS; i++)
+	{
+		CPSignalsToOutputs(&cpState, xio, i & 0x01);
+		CPTurnoutsToOutputs(&cpState, xio);
+	}
+	hostBenchReport("CPSignals/TurnoutsToOutputs", &start, eeReads);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	eeReads = hostEepromReads;
+	for (i=0; i<HOST_BENCH_ITERATIONS; i++)
+	{
+		xioOutputWrite(&xio[0]);
+		xioOutputWrite(&xio[1]);
+	}
+	hostBenchReport("xioOutputWrite (x2)", &start, eeReads);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	eeReads = hostEepromReads;
+	for (i=0; i<HOST_BENCH_ITERATIONS; i++)
+		cpStateToStatusPacket(&cpState, mrbTxBuffer, CP_DIRTY_ALL);
+	hostBenchReport("cpStateToStatusPacket (all dirty)", &start, eeReads);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	eeReads = hostEepromReads;
+	for (i=0; i<HOST_BENCH_ITERATIONS; i++)
+	{
+		uint8_t dirty = CPStateDirtyTake(&cpState);
+		if (dirty)
+			cpStateToStatusPacket(&cpState, mrbTxBuffer, dirty);
+	}
+	hostBenchReport("cpStateToStatusPacket (quiet)", &start, eeReads);
+
+	// Packet CRC check, old per-byte loop against the table.  This is host
+	//  time - send 'D' 'C' to a CP_PROFILE build for AVR cycle counts.
+	{
+		static const uint8_t crcLengths[] = { 6, 12, 20 };
+		uint8_t pkt[MRBUS_BUFFER_SIZE];
+		volatile bool valid;
+		char name[40];
+
+		for (uint8_t l=0; l<sizeof(crcLengths); l++)
+		{
+			hostCrcPacketBuild(pkt, crcLengths[l]);
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			eeReads = hostEepromReads;
+			for (i=0; i<HOST_BENCH_ITERATIONS; i++)
+				valid = hostCrcValidReference(pkt);
+			snprintf(name, sizeof(name), "CRC nibble loop (%u bytes)", crcLengths[l]);
+			hostBenchReport(name, &start, eeReads);
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			eeReads = hostEepromReads;
+			for (i=0; i<HOST_BENCH_ITERATIONS; i++)
+				valid = pktCrcValid(pkt, sizeof(pkt));
+			snprintf(name, sizeof(name), "CRC pktCrcValid (%u bytes)", crcLengths[l]);
+			hostBenchReport(name, &start, eeReads);
+		}
+		(void)valid;
+	}
+}
+
+// Everything the aspect logic reads, besides the route bits
+static const CPInputNames_t hostVerifyOccupancy[] =
+{
+	VOCC_M1E_ADJOIN, VOCC_M1E_APPROACH, VOCC_M1E_APPROACH2,
+	VOCC_M1W_ADJOIN, VOCC_M1W_APPROACH, VOCC_M1W_APPROACH2,
+	VOCC_M2E_ADJOIN, VOCC_M2E_APPROACH, VOCC_M2E_APPROACH2,
+	VOCC_M2W_ADJOIN, VOCC_M2W_APPROACH, VOCC_M2W_APPROACH2,
+	VOCC_M3W_ADJOIN, VOCC_M3W_APPROACH, VOCC_M3W_APPROACH2,
+};
+
+#define HOST_VERIFY_OCCUPANCY_BITS  (sizeof(hostVerifyOccupancy) / sizeof(CPInputNames_t))
+#define HOST_VERIFY_MAX_REPORTS     10
+
+static const CPTurnoutNames_t hostVerifyTurnouts[] = { TURNOUT_E_XOVER, TURNOUT_W_XOVER, TURNOUT_M1_M3 };
+static const CPTimelockState_t hostVerifyTimelock[] = { STATE_LOCKED, STATE_TIMERUN, STATE_UNLOCKED, STATE_RELOCKING };
+
+static uint64_t hostVerifyChecked = 0;
+static uint32_t hostVerifyFailed = 0;
+
+static CPInputMask_t hostVerifyInputs(uint32_t occupancy)
+{
+	CPInputMask_t inputs = 0;
+	for (uint8_t bit=0; bit<HOST_VERIFY_OCCUPANCY_BITS; bit++)
+	{
+		if (occupancy & (1UL<<bit))
+			inputs |= INPUT_MASK(hostVerifyOccupancy[bit]);
+	}
+	return inputs;
+}
+
+static void hostVerifyTurnoutsSet(CPState_t* cpState, uint8_t actual, uint8_t requested)
+{
+	for (uint8_t t=0; t<sizeof(hostVerifyTurnouts) / sizeof(CPTurnoutNames_t); t++)
+	{
+		cpState->turnouts[hostVerifyTurnouts[t]].isNormal = (actual & (1<<t)) ? true : false;
+		cpState->turnouts[hostVerifyTurnouts[t]].isRequestedNormal = (requested & (1<<t)) ? true : false;
+	}
+}
+
+static void hostVerifyCheck(CPState_t* cpState)
+{
+	SignalHeadAspect_t expected[SIG_END];
+	SignalHeadAspect_t actual[SIG_END];
+
+	hostVitalAspectsReference(cpState, expected);
+	vitalLogicAspects(cpState, actual);
+	hostVerifyChecked++;
+
+	if (0 == memcmp(expected, actual, sizeof(expected)))
+		return;
+
+	if (hostVerifyFailed++ < HOST_VERIFY_MAX_REPORTS)
+	{
+		printf("MISMATCH routes %04X inputs %08X timelock %u turnouts", cpState->routes, cpState->inputs,
+			CPTimelockStateGet(cpState, MAIN_TIMELOCK));
+		for (uint8_t t=0; t<TURNOUT_END; t++)
+			printf(" %u/%u", cpState->turnouts[t].isNormal, cpState->turnouts[t].isRequestedNormal);
+		printf("\n   expected");
+		for (uint8_t i=0; i<SIG_END; i++)
+			printf(" %u", expected[i]);
+		printf("\n   tables  ");
+		for (uint8_t i=0; i<SIG_END; i++)
+			printf(" %u", actual[i]);
+		printf("\n");
+	}
+}
+
+// Routes and turnout locks have to come out the same
+static void hostVerifyStateCheck(CPState_t* expected, CPState_t* tables, const char* what)
+{
+	bool match = (expected->routes == tables->routes);
+
+	for (uint8_t t=0; t<TURNOUT_END; t++)
+	{
+		if (expected->turnouts[t].isLocked != tables->turnouts[t].isLocked)
+			match = false;
+	}
+
+	hostVerifyChecked++;
+	if (match)
+		return;
+
+	if (hostVerifyFailed++ < HOST_VERIFY_MAX_REPORTS)
+	{
+		printf("MISMATCH %s: routes %04X/%04X, locks", what, expected->routes, tables->routes);
+		for (uint8_t t=0; t<TURNOUT_END; t++)
+			printf(" %u/%u", expected->turnouts[t].isLocked, tables->turnouts[t].isLocked);
+		printf("\n");
+	}
+}
+
+static void hostVerifyExpect(bool ok, const char* what)
+{
+	hostVerifyChecked++;
+	if (!ok && hostVerifyFailed++ < HOST_VERIFY_MAX_REPORTS)
+		printf("MISMATCH %s\n", what);
+}
+
+// Runs one neighbour packet through the receive queue and PktHandler
+static void hostVerifyPacket(CPState_t* cpState, const uint8_t* data)
+{
+	hostInjectPacket(data);
+	RxQueueDrain(cpState);
+}
+
+// Repeated neighbour status packets - an identical one is skipped, a changed
+//  one right after is still applied, and a run of repeats gets applied again
+//  every CP_VINPUT_REPEAT_MAX + 1 packets
+static void hostVerifyRepeatCache(void)
+{
+	CPState_t cpState;
+	const uint8_t approach[] = { 0xFF, HOST_EAST_ADDR, 8, 'S', 0x02, 0x00 };
+	const uint8_t clear[] = { 0xFF, HOST_EAST_ADDR, 8, 'S', 0x00, 0x00 };
+	uint32_t skipped;
+
+	hostLogging = false;
+	mrbus_dev_addr = HOST_CP_ADDR;
+	mrbusPktQueueInitialize(&mrbusTxQueue, mrbusTxPktBufferArray, txBuffer_DEPTH);
+	mrbusPktQueueInitialize(&mrbusRxQueue, mrbusRxPktBufferArray, rxBuffer_DEPTH);
+	CPInitialize(&cpState);
+	CPMRBusVirtInputRepeatsReset();
+
+	hostVerifyPacket(&cpState, approach);
+	hostVerifyExpect(CPInputStateGet(&cpState, VOCC_M1E_APPROACH), "repeat cache: first packet applied");
+	hostVerifyExpect(0 == CPMRBusVirtInputRepeatsSkipped(), "repeat cache: first packet not skipped");
+
+	// Clear the input behind the cache's back - a skipped repeat won't set it again
+	CPInputStateSet(&cpState, VOCC_M1E_APPROACH, false);
+	hostVerifyPacket(&cpState, approach);
+	hostVerifyExpect(!CPInputStateGet(&cpState, VOCC_M1E_APPROACH), "repeat cache: repeat not applied");
+	hostVerifyExpect(1 == CPMRBusVirtInputRepeatsSkipped(), "repeat cache: repeat counted");
+
+	CPInputStateSet(&cpState, VOCC_M1E_APPROACH, true);
+	hostVerifyPacket(&cpState, clear);
+	hostVerifyExpect(!CPInputStateGet(&cpState, VOCC_M1E_APPROACH), "repeat cache: changed packet applied");
+	hostVerifyExpect(1 == CPMRBusVirtInputRepeatsSkipped(), "repeat cache: changed packet not counted");
+
+	// Nobody touches the input this time, so only the counter shows the refresh
+	for (uint8_t n=0; n<CP_VINPUT_REPEAT_MAX + 1; n++)
+		hostVerifyPacket(&cpState, clear);
+	skipped = CPMRBusVirtInputRepeatsSkipped();
+	hostVerifyExpect(1 + CP_VINPUT_REPEAT_MAX == skipped, "repeat cache: refreshed after CP_VINPUT_REPEAT_MAX repeats");
+
+	hostLogging = true;
+}
+
+// Reads until the pin's debounced level follows the raw one, returning how
+//  many samples that took (0 if it never did)
+static uint8_t hostVerifyDebounceSamples(XIOControl* xio, uint8_t port, uint8_t bit, bool level)
+{
+	hostXioSetInputPin(1, port, bit, level);
+	for (uint8_t n=1; n<=2*(1<<XIO_DEBOUNCE_MAX_WIDTH); n++)
+	{
+		xioInputRead(xio);
+		if (xioGetDebouncedIObyPortBit(xio, port, bit) == level)
+			return n;
+	}
+	return 0;
+}
+
+// The receive push wrapper - uninteresting packets never get a slot, and
+//  interesting ones that don't fit are counted as overflows
+static void hostVerifyRxQueue(void)
+{
+	CPState_t cpState;
+	uint8_t pkt[MRBUS_BUFFER_SIZE];
+	uint8_t n;
+
+	hostLogging = false;
+	mrbus_dev_addr = HOST_CP_ADDR;
+	mrbusPktQueueInitialize(&mrbusRxQueue, mrbusRxPktBufferArray, rxBuffer_DEPTH);
+	CPInitialize(&cpState);
+	memset((void*)&rxFilterStats, 0, sizeof(rxFilterStats));
+	memset((void*)&rxQueueStats, 0, sizeof(rxQueueStats));
+
+	memset(pkt, 0, sizeof(pkt));
+	pkt[MRBUS_PKT_DEST] = 0xFF;
+	pkt[MRBUS_PKT_SRC] = HOST_CP_ADDR;
+	pkt[MRBUS_PKT_LEN] = 8;
+	pkt[MRBUS_PKT_TYPE] = 'S';
+	hostVerifyExpect(mrbusPktQueuePush(&mrbusRxQueue, pkt, 8), "rx queue: loopback taken");
+	hostVerifyExpect(0 == mrbusPktQueueDepth(&mrbusRxQueue), "rx queue: loopback not queued");
+	hostVerifyExpect(1 == rxFilterStats.dropped, "rx queue: loopback counted as dropped");
+
+	pkt[MRBUS_PKT_SRC] = HOST_EAST_ADDR;
+	for (n=0; n<rxBuffer_DEPTH + 2; n++)
+		mrbusPktQueuePush(&mrbusRxQueue, pkt, 8);
+	hostVerifyExpect(rxBuffer_DEPTH == rxFilterStats.accepted, "rx queue: filled");
+	hostVerifyExpect(rxBuffer_DEPTH == rxQueueStats.highWater, "rx queue: high water at full");
+	hostVerifyExpect(2 == rxQueueStats.overflows, "rx queue: overflows counted");
+
+	while (mrbusPktQueueDepth(&mrbusRxQueue))
+		mrbusPktQueueDrop(&mrbusRxQueue);
+	memset((void*)&rxFilterStats, 0, sizeof(rxFilterStats));
+	memset((void*)&rxQueueStats, 0, sizeof(rxQueueStats));
+	hostLogging = true;
+}
+
+// Per-pin debounce widths - a fast assert with a slow release on A3 (20ms/80ms),
+//  and A4 keeping its port's own width going high but releasing at 40ms
+static const XIODebouncePinWidths hostVerifyPinWidths PROGMEM =
+{
+	.assertPins = 1<<3,
+	.releasePins = (1<<3) | (1<<4),
+	.releaseEnable = { (1<<3) | (1<<4), 1<<3, 0, 0 },
+};
+
+static void hostVerifyDebounce(void)
+{
+	XIOControl xio;
+	const uint8_t xio1PinDirection[5] = { 0xF8, 0x01, 0x00, 0x00, 0x00 };
+
+	hostLogging = false;
+	xioInitialize(&xio, I2C_XIO1_ADDRESS, xio1PinDirection);
+	xioSetDebounceWidth(&xio, XIO_PORT_A, DEBOUNCE_160MS);
+	xioSetDebouncePinWidths(&xio, &hostVerifyPinWidths);
+	hostVerifyDebounceSamples(&xio, XIO_PORT_A, 3, false);
+	hostVerifyDebounceSamples(&xio, XIO_PORT_A, 4, false);
+	hostVerifyDebounceSamples(&xio, XIO_PORT_A, 5, false);
+
+	hostVerifyExpect(1 == hostVerifyDebounceSamples(&xio, XIO_PORT_A, 3, true), "debounce: 20ms assert");
+	hostVerifyExpect(4 == hostVerifyDebounceSamples(&xio, XIO_PORT_A, 3, false), "debounce: 80ms release");
+	hostVerifyExpect(8 == hostVerifyDebounceSamples(&xio, XIO_PORT_A, 4, true), "debounce: port width assert");
+	hostVerifyExpect(2 == hostVerifyDebounceSamples(&xio, XIO_PORT_A, 4, false), "debounce: 40ms release");
+	hostVerifyExpect(8 == hostVerifyDebounceSamples(&xio, XIO_PORT_A, 5, true), "debounce: port width pin assert");
+	hostVerifyExpect(8 == hostVerifyDebounceSamples(&xio, XIO_PORT_A, 5, false), "debounce: port width pin release");
+
+	// Put the pins back the way the scenario setup left them
+	hostXioSetInputPin(1, XIO_PORT_A, 3, true);
+	hostXioSetInputPin(1, XIO_PORT_A, 4, true);
+	hostXioSetInputPin(1, XIO_PORT_A, 5, true);
+	hostLogging = true;
+}
+
+// The expedite decision is against what a head is showing - green to red to
+//  yellow before the next output write is still expedited, red to green and
+//  back to red isn't
+static void hostVerifyExpedite(void)
+{
+	CPState_t cpState;
+	XIOControl xio[2];
+	const uint8_t xio0PinDirection[5] = { 0x00, 0x00, 0x00, 0x80, 0x00 };
+	const uint8_t xio1PinDirection[5] = { 0xF8, 0x01, 0x00, 0x00, 0x00 };
+
+	hostLogging = false;
+	xioInitialize(&xio[0], I2C_XIO0_ADDRESS, xio0PinDirection);
+	xioInitialize(&xio[1], I2C_XIO1_ADDRESS, xio1PinDirection);
+	CPInitialize(&cpState);
+	CPSignalHeadSetAspect(&cpState, SIG_MAIN1_E_UPPER, ASPECT_GREEN);
+	CPSignalsToOutputs(&cpState, xio, false);
+
+	CPSignalHeadSetAspect(&cpState, SIG_MAIN1_E_UPPER, ASPECT_RED);
+	CPSignalHeadSetAspect(&cpState, SIG_MAIN1_E_UPPER, ASPECT_YELLOW);
+	hostVerifyExpect(CPOutputsExpedited(&cpState), "expedite: green to red to yellow expedited");
+	CPExpeditedToOutputs(&cpState, xio, false);
+	hostVerifyExpect(!CPOutputsExpedited(&cpState), "expedite: cleared once written");
+
+	CPSignalHeadSetAspect(&cpState, SIG_MAIN1_E_UPPER, ASPECT_GREEN);
+	CPSignalHeadSetAspect(&cpState, SIG_MAIN1_E_UPPER, ASPECT_RED);
+	hostVerifyExpect(CPOutputsExpedited(&cpState), "expedite: yellow to green to red expedited");
+	CPSignalHeadSetAspect(&cpState, SIG_MAIN1_E_UPPER, ASPECT_YELLOW);
+	hostVerifyExpect(!CPOutputsExpedited(&cpState), "expedite: back to the shown aspect not expedited");
+
+	CPSignalHeadSetAspect(&cpState, SIG_MAIN2_E_UPPER, ASPECT_GREEN);
+	CPSignalHeadSetAspect(&cpState, SIG_MAIN2_E_UPPER, ASPECT_RED);
+	hostVerifyExpect(!CPOutputsExpedited(&cpState), "expedite: red to green to red not expedited");
+
+	hostLogging = true;
+}
+
+// ROUTE_NONE isn't a route anybody can set, so the route bits start at bit 1
+#define HOST_VERIFY_ROUTE_MASKS  (1UL<<(ROUTE_END - 1))
+
+static int hostRunVerify(void)
+{
+	CPState_t cpState;
+	uint32_t occupancy, routes;
+	uint8_t actual, requested, lock, bit;
+	struct timespec start;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	CPInitialize(&cpState);
+
+	// Timelock locked and turnouts settled normal - every route and occupancy
+	//  combination, including routes that could never be coded together
+	cpState.timelocks[MAIN_TIMELOCK].state = STATE_LOCKED;
+	hostVerifyTurnoutsSet(&cpState, 0x07, 0x07);
+	for (occupancy=0; occupancy < (1UL<<HOST_VERIFY_OCCUPANCY_BITS); occupancy++)
+	{
+		cpState.inputs = hostVerifyInputs(occupancy);
+		for (routes=0; routes < HOST_VERIFY_ROUTE_MASKS; routes++)
+		{
+			cpState.routes = routes<<1;
+			hostVerifyCheck(&cpState);
+		}
+	}
+
+	// Every timelock state and turnout position, settled or moving, with every
+	//  route combination.  Occupancy is none, all, or one block at a time.
+	for (lock=0; lock<sizeof(hostVerifyTimelock) / sizeof(CPTimelockState_t); lock++)
+	{
+		cpState.timelocks[MAIN_TIMELOCK].state = hostVerifyTimelock[lock];
+		for (actual=0; actual<8; actual++)
+		{
+			for (requested=0; requested<8; requested++)
+			{
+				hostVerifyTurnoutsSet(&cpState, actual, requested);
+				for (routes=0; routes < HOST_VERIFY_ROUTE_MASKS; routes++)
+				{
+					cpState.routes = routes<<1;
+					cpState.inputs = 0;
+					hostVerifyCheck(&cpState);
+					cpState.inputs = hostVerifyInputs((1UL<<HOST_VERIFY_OCCUPANCY_BITS) - 1);
+					hostVerifyCheck(&cpState);
+					for (bit=0; bit<HOST_VERIFY_OCCUPANCY_BITS; bit++)
+					{
+						cpState.inputs = INPUT_MASK(hostVerifyOccupancy[bit]);
+						hostVerifyCheck(&cpState);
+					}
+				}
+			}
+		}
+	}
+
+	printf("aspect tables: %llu states checked, %u mismatches\n", (unsigned long long)hostVerifyChecked, hostVerifyFailed);
+
+	// Route coding, clearing and dropping on occupancy.  Only the outcome is
+	//  compared - the old cpCodeRoute() didn't return true consistently.
+	hostVerifyChecked = 0;
+	for (lock=0; lock<sizeof(hostVerifyTimelock) / sizeof(CPTimelockState_t); lock++)
+	{
+		cpState.timelocks[MAIN_TIMELOCK].state = hostVerifyTimelock[lock];
+		for (requested=0; requested<8; requested++)
+		{
+			for (actual=0; actual<(1<<TURNOUT_END); actual++)
+			{
+				// Here "actual" is which turnouts start out locked
+				hostVerifyTurnoutsSet(&cpState, requested, requested);
+				for (uint8_t t=0; t<TURNOUT_END; t++)
+					cpState.turnouts[t].isLocked = (actual & (1<<t)) ? true : false;
+
+				for (routes=0; routes < HOST_VERIFY_ROUTE_MASKS; routes++)
+				{
+					CPState_t expected, tables;
+					cpState.routes = routes<<1;
+					cpState.inputs = 0;
+
+					for (uint8_t entrance=ROUTE_ENTR_NONE; entrance<=ROUTE_ENTR_M3_EASTBOUND; entrance++)
+					{
+						for (uint8_t setRoute=0; setRoute<2; setRoute++)
+						{
+							expected = tables = cpState;
+							hostCodeRouteReference(&expected, entrance, setRoute);
+							cpCodeRoute(&tables, entrance, setRoute);
+							hostVerifyStateCheck(&expected, &tables, "cpCodeRoute");
+						}
+					}
+
+					for (bit=0; bit<4; bit++)
+					{
+						cpState.inputs = ((bit & 0x01) ? INPUT_MASK(VOCC_M1_OS) : 0) | ((bit & 0x02) ? INPUT_MASK(VOCC_M2_OS) : 0);
+						expected = tables = cpState;
+						hostVitalRoutesReference(&expected);
+						vitalLogicRoutes(&tables);
+						hostVerifyStateCheck(&expected, &tables, "vitalLogicRoutes");
+					}
+				}
+			}
+		}
+	}
+
+	printf("route table: %llu states checked, %u mismatches total\n", (unsigned long long)hostVerifyChecked, hostVerifyFailed);
+
+	// Packet CRC - every CRC and data byte through pktCrcUpdate(), then
+	//  random packets of every length, intact and with one byte flipped
+	hostVerifyChecked = 0;
+	for (uint32_t crc=0; crc<0x10000; crc++)
+	{
+		for (uint16_t a=0; a<0x100; a++)
+		{
+			hostVerifyChecked++;
+			if (pktCrcUpdate(crc, a) != mrbusCRC16Update(crc, a) && hostVerifyFailed++ < HOST_VERIFY_MAX_REPORTS)
+				printf("MISMATCH pktCrcUpdate crc=%04X a=%02X\n", crc, a);
+		}
+	}
+
+	srand(1);
+	for (uint32_t n=0; n<100000; n++)
+	{
+		uint8_t pkt[MRBUS_BUFFER_SIZE];
+		uint8_t len = n % (MRBUS_BUFFER_SIZE + 1);
+		hostCrcPacketBuild(pkt, len);
+		if (n & 0x01)
+		{
+			// Not the length byte - the old loop would run off the buffer
+			uint8_t flip = rand() % (MRBUS_BUFFER_SIZE - 1);
+			pkt[flip + (flip >= MRBUS_PKT_LEN)] ^= 1 << (rand() & 0x07);
+		}
+
+		// Packets too short for a header are rejected outright now
+		bool expected = (pkt[MRBUS_PKT_LEN] >= MRBUS_PKT_TYPE) && hostCrcValidReference(pkt);
+		hostVerifyChecked++;
+		if (expected != pktCrcValid(pkt, sizeof(pkt)) && hostVerifyFailed++ < HOST_VERIFY_MAX_REPORTS)
+			printf("MISMATCH pktCrcValid len=%u\n", pkt[MRBUS_PKT_LEN]);
+	}
+
+	printf("packet crc: %llu checks, %u mismatches total\n", (unsigned long long)hostVerifyChecked, hostVerifyFailed);
+
+	hostVerifyChecked = 0;
+	hostVerifyRepeatCache();
+	printf("repeat cache: %llu checks, %u mismatches total\n", (unsigned long long)hostVerifyChecked, hostVerifyFailed);
+
+	hostVerifyChecked = 0;
+	hostVerifyRxQueue();
+	printf("rx queue: %llu checks, %u mismatches total\n", (unsigned long long)hostVerifyChecked, hostVerifyFailed);
+
+	hostVerifyChecked = 0;
+	hostVerifyExpedite();
+	printf("expedite: %llu checks, %u mismatches total\n", (unsigned long long)hostVerifyChecked, hostVerifyFailed);
+
+	hostVerifyChecked = 0;
+	hostVerifyDebounce();
+	printf("debounce: %llu checks, %u mismatches total\n", (unsigned long long)hostVerifyChecked, hostVerifyFailed);
+	fprintf(stderr, "verify: %.1f s\n", hostElapsedNs(&start) / 1e9);
+	return hostVerifyFailed ? 1 : 0;
+}
+
+static const char* const hostAspectNames[] =
+{
+	"ASPECT_OFF", "ASPECT_GREEN", "ASPECT_YELLOW", "ASPECT_FL_YELLOW",
+	"ASPECT_RED", "ASPECT_FL_GREEN", "ASPECT_FL_RED", "ASPECT_LUNAR"
+};
+
+static const char* const hostSignalNames[SIG_END] =
+{
+	"SIG_MAIN1_E_UPPER", "SIG_MAIN1_E_LOWER", "SIG_MAIN2_E_UPPER", "SIG_MAIN2_E_LOWER",
+	"SIG_MAIN1_W_UPPER", "SIG_MAIN1_W_LOWER", "SIG_MAIN2_W_UPPER", "SIG_MAIN2_W_LOWER",
+	"SIG_MAIN3_W_UPPER", "SIG_MAIN3_W_LOWER"
+};
+
+static void hostTablesIndex(uint8_t idx, const char* const* bitNames)
+{
+	bool first = true;
+
+	printf("\t[");
+	for (int8_t bit=2; bit>=0; bit--)
+	{
+		if (!(idx & (1<<bit)))
+			continue;
+		printf("%s%s", first ? "" : " | ", bitNames[bit]);
+		first = false;
+	}
+	printf("%s] = ", first ? "0" : "");
+}
+
+// Works the aspect tables in config-aspects.h out from the original logic in
+//  vital-reference.h and prints them ready to paste in.  Exits nonzero if the
+//  compiled-in tables don't match, or if the routes disagree on occupancy.
+static int hostRunTables(void)
+{
+	static const char* const occBits[] = { "CP_OCC_ADJOIN", "CP_OCC_APPROACH", "CP_OCC_APPROACH2" };
+	static const char* const turnoutBits[] = { "CP_UNLOCKED_M1_M3_NORMAL", "CP_UNLOCKED_W_XOVER_NORMAL", "CP_UNLOCKED_E_XOVER_NORMAL" };
+	CPState_t cpState;
+	SignalHeadAspect_t aspects[SIG_END];
+	uint8_t occupancyAspect[8];
+	uint16_t unlockedRestricting[8];
+	uint8_t occupancyInputs[3];
+	int failed = 0;
+	uint8_t i, idx, head;
+
+	CPInitialize(&cpState);
+
+	// Every route's clear head, settled and locked, through each occupancy code
+	cpState.timelocks[MAIN_TIMELOCK].state = STATE_LOCKED;
+	for (i=0; i<CP_ROUTE_DEFS; i++)
+	{
+		uint8_t reversed = pgm_read_byte(&cpRouteDefs[i].turnoutsReversed);
+		for (uint8_t t=0; t<TURNOUT_END; t++)
+			cpState.turnouts[t].isNormal = cpState.turnouts[t].isRequestedNormal = !(reversed & TURNOUT_MASK(t));
+		cpState.routes = ROUTE_MASK(pgm_read_byte(&cpRouteDefs[i].route));
+		memcpy_P(occupancyInputs, cpRouteDefs[i].occupancy, sizeof(occupancyInputs));
+		head = pgm_read_byte(&cpRouteDefs[i].clearHead);
+
+		for (idx=0; idx<8; idx++)
+		{
+			cpState.inputs = 0;
+			for (uint8_t bit=0; bit<3; bit++)
+			{
+				if (idx & (1<<bit))
+					cpState.inputs |= INPUT_MASK(occupancyInputs[bit]);
+			}
+			hostVitalAspectsReference(&cpState, aspects);
+			if (0 == i)
+				occupancyAspect[idx] = aspects[head];
+			else if (occupancyAspect[idx] != aspects[head])
+			{
+				printf("// route table entry %u disagrees at occupancy %u\n", i, idx);
+				failed = 1;
+			}
+		}
+	}
+
+	// Every settled turnout position with the timelock unlocked and no routes
+	cpState.timelocks[MAIN_TIMELOCK].state = STATE_UNLOCKED;
+	cpState.routes = 0;
+	cpState.inputs = 0;
+	for (idx=0; idx<8; idx++)
+	{
+		cpState.turnouts[TURNOUT_E_XOVER].isNormal = cpState.turnouts[TURNOUT_E_XOVER].isRequestedNormal = (idx & CP_UNLOCKED_E_XOVER_NORMAL) ? true : false;
+		cpState.turnouts[TURNOUT_W_XOVER].isNormal = cpState.turnouts[TURNOUT_W_XOVER].isRequestedNormal = (idx & CP_UNLOCKED_W_XOVER_NORMAL) ? true : false;
+		cpState.turnouts[TURNOUT_M1_M3].isNormal = cpState.turnouts[TURNOUT_M1_M3].isRequestedNormal = (idx & CP_UNLOCKED_M1_M3_NORMAL) ? true : false;
+		hostVitalAspectsReference(&cpState, aspects);
+		unlockedRestricting[idx] = 0;
+		for (head=0; head<SIG_END; head++)
+		{
+			if (ASPECT_FL_RED == aspects[head])
+				unlockedRestricting[idx] |= SIG_MASK(head);
+		}
+	}
+
+	printf("static const uint8_t cpOccupancyAspect[8] PROGMEM =\n{\n");
+	for (idx=0; idx<8; idx++)
+	{
+		hostTablesIndex(idx, occBits);
+		printf("%s,\n", hostAspectNames[occupancyAspect[idx]]);
+		if (occupancyAspect[idx] != pgm_read_byte(&cpOccupancyAspect[idx]))
+			failed = 1;
+	}
+	printf("};\n\nstatic const uint16_t cpUnlockedRestricting[8] PROGMEM =\n{\n");
+	for (idx=0; idx<8; idx++)
+	{
+		bool first = true;
+		hostTablesIndex(idx, turnoutBits);
+		for (head=0; head<SIG_END; head++)
+		{
+			if (!(unlockedRestricting[idx] & SIG_MASK(head)))
+				continue;
+			printf("%sSIG_MASK(%s)", first ? "" : " | ", hostSignalNames[head]);
+			first = false;
+		}
+		printf("%s,\n", first ? "0" : "");
+		if (unlockedRestricting[idx] != pgm_read_word(&cpUnlockedRestricting[idx]))
+			failed = 1;
+	}
+	printf("};\n");
+
+	fprintf(stderr, "tables: %s config-aspects.h\n", failed ? "DO NOT MATCH" : "match");
+	return failed;
+}
+
+int main(int argc, char** argv)
+{
+	hostEepromSetup();
+	hostXioSetup();
+
+	if (argc > 1 && 0 == strcmp(argv[1], "verify"))
+		return hostRunVerify();
+
+	if (argc > 1 && 0 == strcmp(argv[1], "tables"))
+		return hostRunTables();
+
+	if (argc > 1 && 0 == strcmp(argv[1], "bench"))
+	{
+		hostRunBench();
+		return 0;
+	}
+
+	return hostRunScenario();
+}
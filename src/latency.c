@@ -0,0 +1,169 @@
+/*************************************************************************
+Title:    Stimulus to Output Latency Tracking
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     latency.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "timestamp.h"
+#include "latency.h"
+
+// Where a stimulus is on its way to the pins
+#define LATENCY_STAGE_NONE      0
+#define LATENCY_STAGE_DEBOUNCE  1  // Raw input change, waiting on the debouncer to accept it
+#define LATENCY_STAGE_LOGIC     2  // Waiting on the vital logic to act on it
+#define LATENCY_STAGE_OUTPUT    3  // Logic changed something, waiting on an output write
+#define LATENCY_STAGE_COMMIT    4  // Output write queued, waiting on it to hit the bus
+
+typedef struct
+{
+	uint32_t start;
+	uint8_t stage;
+} LatencyPending_t;
+
+static LatencyPending_t latencyPending[LATENCY_END];
+static LatencyStats_t latencyStats[LATENCY_END];
+
+void latencyReset(void)
+{
+	uint8_t i;
+	memset(latencyStats, 0, sizeof(latencyStats));
+	for(i=0; i<LATENCY_END; i++)
+		latencyStats[i].min = 0xFFFF;
+}
+
+void latencyStimulus(LatencyClass_t latencyClass)
+{
+	if (latencyClass < LATENCY_END && LATENCY_STAGE_NONE == latencyPending[latencyClass].stage)
+	{
+		latencyPending[latencyClass].start = timestampGet();
+		latencyPending[latencyClass].stage = LATENCY_STAGE_LOGIC;
+	}
+}
+
+// An XIO input pin changed at timestamp 'when' - the clock starts there, but
+//  the logic doesn't see anything until the debouncer accepts the change
+void latencyInputEdge(uint32_t when)
+{
+	if (LATENCY_STAGE_NONE == latencyPending[LATENCY_INPUT].stage)
+	{
+		latencyPending[LATENCY_INPUT].start = when;
+		latencyPending[LATENCY_INPUT].stage = LATENCY_STAGE_DEBOUNCE;
+	}
+}
+
+// Call after each pass of the XIO input filter.  A change the debouncer threw
+//  away is dropped once nothing is left debouncing.
+void latencyInputDebounced(bool accepted, bool stillDebouncing)
+{
+	if (LATENCY_STAGE_DEBOUNCE != latencyPending[LATENCY_INPUT].stage)
+		return;
+
+	if (accepted)
+		latencyPending[LATENCY_INPUT].stage = LATENCY_STAGE_LOGIC;
+	else if (!stillDebouncing)
+		latencyPending[LATENCY_INPUT].stage = LATENCY_STAGE_NONE;
+}
+
+// Anything the logic didn't turn into an output change has nothing to measure
+void latencyLogicDone(bool outputsChanged)
+{
+	uint8_t i;
+	for(i=0; i<LATENCY_END; i++)
+	{
+		if (LATENCY_STAGE_LOGIC == latencyPending[i].stage)
+			latencyPending[i].stage = outputsChanged?LATENCY_STAGE_OUTPUT:LATENCY_STAGE_NONE;
+	}
+}
+
+void latencyOutputsQueued(void)
+{
+	uint8_t i;
+	for(i=0; i<LATENCY_END; i++)
+	{
+		if (LATENCY_STAGE_OUTPUT == latencyPending[i].stage)
+			latencyPending[i].stage = LATENCY_STAGE_COMMIT;
+	}
+}
+
+static void latencyRecord(LatencyStats_t* stats, uint32_t elapsed)
+{
+	uint16_t t;
+	uint8_t bin;
+
+	// Counts to 0.1ms, pinned at the top of what fits
+	elapsed /= (TIMESTAMP_COUNTS_PER_MS / 10);
+	t = (elapsed > 0xFFFF) ? 0xFFFF : elapsed;
+
+	if (t <= LATENCY_BIN0_MAX)
+		bin = 0;
+	else if (t <= LATENCY_BIN1_MAX)
+		bin = 1;
+	else if (t <= LATENCY_BIN2_MAX)
+		bin = 2;
+	else if (t <= LATENCY_BIN3_MAX)
+		bin = 3;
+	else if (t <= LATENCY_BIN4_MAX)
+		bin = 4;
+	else
+		bin = 5;
+
+	// Stop everything together once the count saturates so the mean stays honest
+	if (0xFFFF == stats->count)
+		return;
+
+	stats->count++;
+	stats->sum += t;
+	if (t < stats->min)
+		stats->min = t;
+	if (t > stats->max)
+		stats->max = t;
+	stats->histogram[bin]++;
+}
+
+// Call once the output writes have all gone out on the bus
+void latencyOutputsCommitted(void)
+{
+	uint8_t i;
+	uint32_t now = timestampGet();
+
+	for(i=0; i<LATENCY_END; i++)
+	{
+		if (LATENCY_STAGE_COMMIT != latencyPending[i].stage)
+			continue;
+
+		latencyRecord(&latencyStats[i], now - latencyPending[i].start);
+		latencyPending[i].stage = LATENCY_STAGE_NONE;
+	}
+}
+
+const LatencyStats_t* latencyStatsGet(LatencyClass_t latencyClass)
+{
+	if (latencyClass >= LATENCY_END)
+		return NULL;
+	return &latencyStats[latencyClass];
+}
+
+uint16_t latencyMean(const LatencyStats_t* stats)
+{
+	if (0 == stats->count)
+		return 0;
+	return stats->sum / stats->count;
+}
@@ -0,0 +1,70 @@
+/*************************************************************************
+Title:    Stimulus to Output Latency Tracking Header
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     latency.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Measures how long it takes from something happening - an XIO input pin
+//  changing or a CTC command arriving - until the outputs it caused are on the
+//  XIO pins.  Each class tracks one stimulus at a time; anything that shows up
+//  while one is already in flight rides along with it.
+//
+// Input timing starts at the XIO interrupt, so it includes the debounce.
+//  Inputs coming in over MRBus from the neighbours aren't counted.
+
+typedef enum
+{
+	LATENCY_INPUT = 0,
+	LATENCY_CTC,
+	LATENCY_END
+} LatencyClass_t;
+
+// Histogram bin upper edges, in 0.1ms - the last bin catches everything else
+#define LATENCY_HISTOGRAM_BINS  6
+#define LATENCY_BIN0_MAX    50
+#define LATENCY_BIN1_MAX   100
+#define LATENCY_BIN2_MAX   200
+#define LATENCY_BIN3_MAX   500
+#define LATENCY_BIN4_MAX  1000
+
+typedef struct
+{
+	uint16_t count;
+	uint16_t min;   // All times in 0.1ms
+	uint16_t max;
+	uint32_t sum;
+	uint16_t histogram[LATENCY_HISTOGRAM_BINS];
+} LatencyStats_t;
+
+void latencyReset(void);
+void latencyStimulus(LatencyClass_t latencyClass);
+void latencyInputEdge(uint32_t when);
+void latencyInputDebounced(bool accepted, bool stillDebouncing);
+void latencyLogicDone(bool outputsChanged);
+void latencyOutputsQueued(void);
+void latencyOutputsCommitted(void);
+const LatencyStats_t* latencyStatsGet(LatencyClass_t latencyClass);
+uint16_t latencyMean(const LatencyStats_t* stats);
+
+#endif
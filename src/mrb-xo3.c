@@ -25,18 +25,28 @@ LICENSE:
 #include <avr/interrupt.h>
 #include <avr/eeprom.h>
 #include <avr/wdt.h>
+#include <avr/sleep.h>
 #include <string.h>
 #include <util/delay.h>
+#include <util/atomic.h>
 
 #include "mrbus.h"
 #include "avr-i2c-master.h"
 #include "busvoltage.h"
 #include "controlpoint.h"
+#include "config-aspects.h"
+#include "config-route-table.h"
+#include "timestamp.h"
+#include "latency.h"
+#include "profile.h"
+#include "pktcrc.h"
+#include "pktqueue.h"
 
 void PktHandler(CPState_t *cpState);
+void RxQueueDrain(CPState_t *cpState);
 
 #define txBuffer_DEPTH 4
-#define rxBuffer_DEPTH 8
+#define rxBuffer_DEPTH 16
 
 MRBusPacket mrbusTxPktBufferArray[txBuffer_DEPTH];
 MRBusPacket mrbusRxPktBufferArray[rxBuffer_DEPTH];
@@ -47,9 +57,19 @@ volatile uint8_t events = 0;
 #define EVENT_READ_INPUTS    0x01
 #define EVENT_WRITE_OUTPUTS  0x02
 #define EVENT_1HZ            0x04
+#define EVENT_INPUTS_UPDATED 0x08
+#define EVENT_XIO_IRQ        0x10
+#define EVENT_XIO_CONFIG     0x20
 #define EVENT_I2C_ERROR      0x40
 #define EVENT_BLINKY         0x80
 
+// Everything but EVENT_BLINKY, which is a state rather than something to do
+#define EVENT_PENDING_MASK   (0xFF & ~EVENT_BLINKY)
+
+// Most times the vital logic can run through once without changing anything
+//  it looks at, but give it a few goes to settle before moving on
+#define VITAL_LOGIC_SETTLE_PASSES  4
+
 #define POINTS_NORMAL_SAFE    'M'
 #define POINTS_REVERSE_SAFE   'D'
 #define POINTS_NORMAL_FORCE   'm'
@@ -90,6 +110,31 @@ volatile uint8_t buttonLockout=5;
 uint8_t updateInterval=10;
 uint8_t i2cResetCounter = 0;
 
+// Outputs only go to the XIOs when they change, but every so often
+//  everything gets resent in case an XIO lost its registers
+#define XIO_REFRESH_TIME_DEFAULT 10
+uint8_t xioRefreshTime = XIO_REFRESH_TIME_DEFAULT;
+
+void readXioRefreshTime(void)
+{
+	xioRefreshTime = eeprom_read_byte((uint8_t*)EE_XIO_REFRESH_TIME);
+	if (0 == xioRefreshTime || 0xFF == xioRefreshTime)
+		xioRefreshTime = XIO_REFRESH_TIME_DEFAULT;
+}
+
+// Per-port debounce widths live in EEPROM, anything out of range gets the default
+//  Inputs with their own assert/release timing in config-hardware.h go on top
+void configureXioDebounce(XIOControl* xio, CPState_t* cpState)
+{
+	uint8_t xioNum, port;
+	for(xioNum=0; xioNum<CP_XIO_COUNT; xioNum++)
+	{
+		for(port=XIO_PORT_A; port<=XIO_PORT_E; port++)
+			xioSetDebounceWidth(&xio[xioNum], port, eeprom_read_byte((uint8_t*)(EE_XIO_DEBOUNCE_WIDTH + 8*xioNum + port)));
+	}
+	CPXIOInputFilterConfigure(cpState, xio);
+}
+
 void initialize100HzTimer(void)
 {
 	// Set up timer 1 for 100Hz interrupts
@@ -131,16 +176,105 @@ ISR(TIMER0_COMPA_vect)
 
 // End of 100Hz timer
 
-void cpLockAllTurnouts(CPState_t* state)
+// The XIO interrupt outputs are open drain and tied together onto I2C_IRQ,
+//  which gets pulled low whenever an unmasked input changes and stays low
+//  until the input registers are read.  I2C_IRQ is on PORTB, so it's
+//  watched with the PCINT0 bank of pin change interrupts.
+#define xioIrqAsserted()  (0 == (PINB & _BV(I2C_IRQ)))
+
+// When the interrupt line first went low, for input latency
+volatile uint32_t xioIrqTimestamp = 0;
+
+void initializeXioInterrupt(void)
 {
-	CPTurnoutLockSet(state, TURNOUT_E_XOVER, true);
-	CPTurnoutLockSet(state, TURNOUT_W_XOVER, true);
+	DDRB &= ~_BV(I2C_IRQ);
+	PORTB |= _BV(I2C_IRQ);
+	PCMSK0 |= _BV(PCINT0 + I2C_IRQ);
+	PCICR |= _BV(PCIE0);
 }
 
-void cpUnlockAllTurnouts(CPState_t* state)
+ISR(PCINT0_vect)
 {
-	CPTurnoutLockSet(state, TURNOUT_E_XOVER, false);
-	CPTurnoutLockSet(state, TURNOUT_W_XOVER, false);
+	if (xioIrqAsserted())
+	{
+		if (!(events & EVENT_XIO_IRQ))
+			xioIrqTimestamp = timestampGet();
+		events |= EVENT_XIO_IRQ;
+	}
+}
+
+// With the interrupt line doing the work, the 50Hz input tick only reads the
+//  XIOs while something is debouncing, plus a slow poll as a safety net
+//  Each XIO gets polled on its own tick so they don't all land on the bus at once
+#define XIO_INPUT_POLL_TICKS  25
+
+#if CP_XIO_COUNT > XIO_INPUT_POLL_TICKS
+#error "Every XIO needs its own tick in the input poll cycle"
+#endif
+
+// These return false if the XIO queue was full and anything didn't get
+//  queued - the caller tries again on the next pass
+bool queueXioInputReads(XIOControl* xio)
+{
+	uint8_t i;
+	bool allQueued = true;
+	// The interrupt line is shared, so there's no telling which one asserted it
+	for(i=0; i<CP_XIO_COUNT; i++)
+	{
+		if (xioHasInputs(&xio[i]) && !xioQueueInputRead(&xio[i]))
+			allQueued = false;
+	}
+	return allQueued;
+}
+
+bool queueXioOutputWrites(XIOControl* xio)
+{
+	uint8_t i;
+	bool allQueued = true;
+	for(i=0; i<CP_XIO_COUNT; i++)
+	{
+		if (!xioQueueOutputWrite(&xio[i]))
+			allQueued = false;
+	}
+	return allQueued;
+}
+
+bool xioAnyDebounceInProgress(XIOControl* xio)
+{
+	uint8_t i;
+	for(i=0; i<CP_XIO_COUNT; i++)
+	{
+		if (xioDebounceInProgress(&xio[i]))
+			return true;
+	}
+	return false;
+}
+
+// Bring up every XIO with its pin directions from the hardware tables
+//  Returns true if they all came up
+bool initializeXios(XIOControl* xio)
+{
+	uint8_t direction[5];
+	bool allInitialized = true;
+	uint8_t i;
+
+	for(i=0; i<CP_XIO_COUNT; i++)
+	{
+		CPXIOPinDirectionsGet(i, direction);
+		xioInitialize(&xio[i], I2C_XIO_ADDRESS(i), direction);
+		if (!xioIsInitialized(&xio[i]))
+			allInitialized = false;
+	}
+	return allInitialized;
+}
+
+void cpTurnoutsLockSet(CPState_t* state, uint8_t turnoutMask, bool setLock)
+{
+	for (uint8_t i=0; i<TURNOUT_END; i++)
+	{
+		if (turnoutMask & TURNOUT_MASK(i))
+			CPTurnoutLockSet(state, i, setLock);
+	}
 }
 
 
@@ -168,6 +302,8 @@ void init(void)
 	// Don't update more than once per second and max out at 25.5s
 	updateInterval = max(10, min(255L, tmp_updateInterval));
 
+	readXioRefreshTime();
+
 	// Setup ADC for bus voltage monitoring
 	busVoltageMonitorInit();
 }
@@ -182,405 +318,109 @@ void CodeCTCRoute(uint8_t controlPoint, uint8_t newPointsE, uint8_t newPointsW,
 
 
 
-static inline void vitalLogic(CPState_t *cpState)
+// Works out every signal aspect from the routes, occupancy, turnouts and
+//  timelock using the tables in config-aspects.h and config-route-table.h
+static inline void vitalLogicAspects(CPState_t *cpState, SignalHeadAspect_t* aspects)
 {
-	bool occupancyMain1 = CPInputStateGet(cpState, VOCC_M1_OS);
-	bool occupancyMain2 = CPInputStateGet(cpState, VOCC_M2_OS);
-
-	// First, if we have occupancy, drop any routes affected
-	if (occupancyMain1 || occupancyMain2)
-	{
-		CPRouteClear(cpState, ROUTE_MAIN2_VIA_MAIN1_EASTBOUND);
-		CPRouteClear(cpState, ROUTE_MAIN2_VIA_MAIN1_WESTBOUND);
-		CPRouteClear(cpState, ROUTE_MAIN1_TO_MAIN2_EASTBOUND);
-		CPRouteClear(cpState, ROUTE_MAIN1_TO_MAIN2_WESTBOUND);
-		CPRouteClear(cpState, ROUTE_MAIN2_TO_MAIN1_EASTBOUND);
-		CPRouteClear(cpState, ROUTE_MAIN2_TO_MAIN1_WESTBOUND);
-
-		CPRouteClear(cpState, ROUTE_MAIN3_TO_MAIN2_EASTBOUND);
-		CPRouteClear(cpState, ROUTE_MAIN2_TO_MAIN3_WESTBOUND);
-	}
-	
-	if (occupancyMain1)
-	{
-		CPRouteClear(cpState, ROUTE_MAIN1_EASTBOUND);
-		CPRouteClear(cpState, ROUTE_MAIN1_WESTBOUND);
-		CPRouteClear(cpState, ROUTE_MAIN1_TO_MAIN3_WESTBOUND);
-		CPRouteClear(cpState, ROUTE_MAIN3_TO_MAIN1_EASTBOUND);
-	}
-	
-	if (occupancyMain2)
-	{
-		CPRouteClear(cpState, ROUTE_MAIN2_EASTBOUND);
-		CPRouteClear(cpState, ROUTE_MAIN2_WESTBOUND);
-	}
-	
-
-	// Now, unlock appropriate turnouts if no routes are set and there's no occupancy
-	if (!(occupancyMain1 || occupancyMain2) && CPRouteNoneSet(cpState))
-	{
-		cpUnlockAllTurnouts(cpState);
-	}
-	
-	/*
-	 * 	ROUTE_NONE,
-	ROUTE_MAIN1_EASTBOUND,
-	ROUTE_MAIN1_WESTBOUND,
-	ROUTE_MAIN2_EASTBOUND,
-	ROUTE_MAIN2_WESTBOUND,
-	ROUTE_MAIN2_VIA_MAIN1_EASTBOUND,
-	ROUTE_MAIN2_VIA_MAIN1_WESTBOUND,
-	ROUTE_MAIN1_TO_MAIN2_EASTBOUND,
-	ROUTE_MAIN1_TO_MAIN2_WESTBOUND,
-	ROUTE_MAIN2_TO_MAIN1_EASTBOUND,
-	ROUTE_MAIN2_TO_MAIN1_WESTBOUND
-	* 
-	* 	SIG_MAIN1_E_UPPER,
-	SIG_MAIN1_E_LOWER,
-	SIG_MAIN2_E_UPPER,
-	SIG_MAIN2_E_LOWER,
-	SIG_MAIN1_W_UPPER,
-	SIG_MAIN1_W_LOWER, 
-	SIG_MAIN2_W_UPPER,
-	SIG_MAIN2_W_LOWER,
-	* 
-	* 	ASPECT_OFF       = 0,
-	ASPECT_GREEN     = 1,
-	ASPECT_YELLOW    = 2,
-	ASPECT_FL_YELLOW = 3,
-	ASPECT_RED       = 4,
-	ASPECT_FL_GREEN  = 5,
-	ASPECT_FL_RED    = 6,
-	ASPECT_LUNAR     = 7
-	* 
-	* 
-	* */
-
-	bool eastCrossover = CPTurnoutActualDirectionGet(cpState, TURNOUT_E_XOVER);
-	bool westCrossover = CPTurnoutActualDirectionGet(cpState, TURNOUT_W_XOVER);
-	bool m1m3Switch = CPTurnoutActualDirectionGet(cpState, TURNOUT_M1_M3);
+	uint8_t occupancyInputs[3];
+	uint8_t groupsDone = 0;
+	uint8_t i;
 
 	// Start out with a safe default - everybody red
-	CPSignalHeadAllSetAspect(cpState, ASPECT_RED);
+	for(i=0; i<SIG_END; i++)
+		aspects[i] = ASPECT_RED;
 
 	if (CPTurnoutRequestedDirectionGet(cpState, TURNOUT_E_XOVER) != CPTurnoutActualDirectionGet(cpState, TURNOUT_E_XOVER)
 		|| CPTurnoutRequestedDirectionGet(cpState, TURNOUT_M1_M3) != CPTurnoutActualDirectionGet(cpState, TURNOUT_M1_M3)
 		|| CPTurnoutRequestedDirectionGet(cpState, TURNOUT_W_XOVER) != CPTurnoutActualDirectionGet(cpState, TURNOUT_W_XOVER))
 	{
 		// Turnouts are in motion - RED!
+		return;
 	}
-	else if (STATE_LOCKED != CPTimelockStateGet(cpState, MAIN_TIMELOCK))
+
+	if (STATE_LOCKED != CPTimelockStateGet(cpState, MAIN_TIMELOCK))
 	{
-		// Timelock isn't locked - RED!
+		// Timelock isn't locked - RED, but if we're actually unlocked put up
+		//  restricting indications where the points allow
 		if (STATE_UNLOCKED == CPTimelockStateGet(cpState, MAIN_TIMELOCK))
 		{
-			// If we're actually unlocked, put up restricting indications where appropriate
-			if (eastCrossover && westCrossover) // Both normal
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_UPPER, ASPECT_FL_RED);
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_UPPER, ASPECT_FL_RED);
+			uint8_t positions = (CPTurnoutActualDirectionGet(cpState, TURNOUT_E_XOVER) ? CP_UNLOCKED_E_XOVER_NORMAL : 0)
+				| (CPTurnoutActualDirectionGet(cpState, TURNOUT_W_XOVER) ? CP_UNLOCKED_W_XOVER_NORMAL : 0)
+				| (CPTurnoutActualDirectionGet(cpState, TURNOUT_M1_M3) ? CP_UNLOCKED_M1_M3_NORMAL : 0);
+			uint16_t restricting = pgm_read_word(&cpUnlockedRestricting[positions]);
 
-				if (m1m3Switch)
-				{
-					// M1-M3 is normal  (against M3)
-					CPSignalHeadSetAspect(cpState, SIG_MAIN1_W_UPPER, ASPECT_FL_RED);
-					CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_UPPER, ASPECT_FL_RED);
-				} else {
-					// M1-M3 is reversed (to M3)
-					CPSignalHeadSetAspect(cpState, SIG_MAIN3_W_UPPER, ASPECT_FL_RED);
-					CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_LOWER, ASPECT_FL_RED);
-				}
-			}
-			else if (eastCrossover && !westCrossover)
+			for(i=0; i<SIG_END; i++)
 			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_LOWER, ASPECT_FL_RED);
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_LOWER, ASPECT_FL_RED);
-			}
-			else if (!eastCrossover && westCrossover)
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_LOWER, ASPECT_FL_RED);
-				if (m1m3Switch)
-				{
-					// M1-M3 is normal  (against M3)
-					CPSignalHeadSetAspect(cpState, SIG_MAIN1_W_LOWER, ASPECT_FL_RED);
-				} else {
-					CPSignalHeadSetAspect(cpState, SIG_MAIN3_W_LOWER, ASPECT_FL_RED);
-				}
-			} else {
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_LOWER, ASPECT_FL_RED);
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_LOWER, ASPECT_FL_RED);
+				if (restricting & SIG_MASK(i))
+					aspects[i] = ASPECT_FL_RED;
 			}
 		}
+		return;
 	}
-	else
+
+	if (CPRouteNoneSet(cpState))
+		return;
+
+	for(i=0; i<CP_ROUTE_DEFS; i++)
 	{
-		// Work through all routes set, setting signals appropriate to state
-		if (CPRouteTest(cpState, ROUTE_MAIN1_EASTBOUND))
-		{
-			CPSignalHeadSetAspect(cpState, SIG_MAIN1_W_LOWER, ASPECT_RED);
-			if (CPInputStateGet(cpState, VOCC_M1E_ADJOIN))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_W_UPPER, ASPECT_RED);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M1E_APPROACH))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_W_UPPER, ASPECT_YELLOW);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M1E_APPROACH2))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_W_UPPER, ASPECT_FL_YELLOW);
-			} else {
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_W_UPPER, ASPECT_GREEN);
-			}
-		}
-		else if (CPRouteTest(cpState, ROUTE_MAIN1_WESTBOUND))
-		{
-			CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_LOWER, ASPECT_RED);
-			if (CPInputStateGet(cpState, VOCC_M1W_ADJOIN))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_UPPER, ASPECT_RED);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M1W_APPROACH))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_UPPER, ASPECT_YELLOW);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M1W_APPROACH2))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_UPPER, ASPECT_FL_YELLOW);
-			} else {
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_UPPER, ASPECT_GREEN);
-			}
-		}
-		else if (CPRouteTest(cpState, ROUTE_MAIN1_TO_MAIN3_WESTBOUND))
-		{
-			CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_UPPER, ASPECT_RED);
-			if (CPInputStateGet(cpState, VOCC_M3W_ADJOIN))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_LOWER, ASPECT_RED);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M3W_APPROACH))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_LOWER, ASPECT_YELLOW);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M3W_APPROACH2))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_LOWER, ASPECT_FL_YELLOW);
-			} else {
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_LOWER, ASPECT_GREEN);
-			}
-		}
-		else if (CPRouteTest(cpState, ROUTE_MAIN3_TO_MAIN1_EASTBOUND))
-		{
-			CPSignalHeadSetAspect(cpState, SIG_MAIN3_W_LOWER, ASPECT_RED);
-			if (CPInputStateGet(cpState, VOCC_M1E_ADJOIN))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN3_W_UPPER, ASPECT_RED);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M1E_APPROACH))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN3_W_UPPER, ASPECT_YELLOW);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M1E_APPROACH2))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN3_W_UPPER, ASPECT_FL_YELLOW);
-			} else {
-				CPSignalHeadSetAspect(cpState, SIG_MAIN3_W_UPPER, ASPECT_GREEN);
-			}
-		}
+		uint8_t route = pgm_read_byte(&cpRouteDefs[i].route);
+		uint8_t group = pgm_read_byte(&cpRouteDefs[i].aspectGroup);
+		if ((groupsDone & (1<<group)) || !CPRouteTest(cpState, route))
+			continue;
+
+		groupsDone |= (1<<group);
+		memcpy_P(occupancyInputs, cpRouteDefs[i].occupancy, sizeof(occupancyInputs));
+		uint8_t occupancy = (CPInputStateGet(cpState, occupancyInputs[0]) ? CP_OCC_ADJOIN : 0)
+			| (CPInputStateGet(cpState, occupancyInputs[1]) ? CP_OCC_APPROACH : 0)
+			| (CPInputStateGet(cpState, occupancyInputs[2]) ? CP_OCC_APPROACH2 : 0);
+		aspects[pgm_read_byte(&cpRouteDefs[i].stopHead)] = ASPECT_RED;
+		aspects[pgm_read_byte(&cpRouteDefs[i].clearHead)] = pgm_read_byte(&cpOccupancyAspect[occupancy]);
+	}
+}
 
+// Drops routes whose OS track is occupied, and unlocks the turnouts once
+//  nothing's set and the plant is clear
+static inline void vitalLogicRoutes(CPState_t *cpState)
+{
+	CPInputMask_t osOccupied = CPInputMaskGet(cpState) & CP_OS_INPUTS;
+	CPRouteMask_t dropRoutes = 0;
+	uint8_t lockedTurnouts = 0;
+	uint8_t i;
 
-		if (CPRouteTest(cpState, ROUTE_MAIN2_EASTBOUND))
-		{
-			CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_LOWER, ASPECT_RED);
-			if (CPInputStateGet(cpState, VOCC_M2E_ADJOIN))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_UPPER, ASPECT_RED);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_UPPER, ASPECT_YELLOW);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH2))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_UPPER, ASPECT_FL_YELLOW);
-			} else {
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_UPPER, ASPECT_GREEN);
-			}
-		} 
-		else if (CPRouteTest(cpState, ROUTE_MAIN2_WESTBOUND))
-		{
-			CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_LOWER, ASPECT_RED);
-			if (CPInputStateGet(cpState, VOCC_M2W_ADJOIN))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_UPPER, ASPECT_RED);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M2W_APPROACH))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_UPPER, ASPECT_YELLOW);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M2W_APPROACH2))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_UPPER, ASPECT_FL_YELLOW);
-			} else {
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_UPPER, ASPECT_GREEN);
-			}
-		}
-		else if (CPRouteTest(cpState, ROUTE_MAIN2_VIA_MAIN1_EASTBOUND))
-		{
-			CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_UPPER, ASPECT_RED);
-			if (CPInputStateGet(cpState, VOCC_M2E_ADJOIN))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_LOWER, ASPECT_RED);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_LOWER, ASPECT_YELLOW);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH2))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_LOWER, ASPECT_FL_YELLOW);
-			} else {
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_LOWER, ASPECT_GREEN);
-			}
-		}
-		else if (CPRouteTest(cpState, ROUTE_MAIN2_VIA_MAIN1_WESTBOUND))
-		{
-			CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_UPPER, ASPECT_RED);
-			if (CPInputStateGet(cpState, VOCC_M2W_ADJOIN))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_LOWER, ASPECT_RED);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M2W_APPROACH))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_LOWER, ASPECT_YELLOW);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M2W_APPROACH2))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_LOWER, ASPECT_FL_YELLOW);
-			} else {
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_LOWER, ASPECT_GREEN);
-			}
-		}
-		
-		// Work through all routes set, setting signals appropriate to state
-		if (CPRouteTest(cpState, ROUTE_MAIN1_TO_MAIN2_EASTBOUND))
-		{
-			CPSignalHeadSetAspect(cpState, SIG_MAIN1_W_UPPER, ASPECT_RED);
-			if (CPInputStateGet(cpState, VOCC_M2E_ADJOIN))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_W_LOWER, ASPECT_RED);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_W_LOWER, ASPECT_YELLOW);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH2))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_W_LOWER, ASPECT_FL_YELLOW);
-			} else {
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_W_LOWER, ASPECT_GREEN);
-			}
-		}
-		else if (CPRouteTest(cpState, ROUTE_MAIN1_TO_MAIN2_WESTBOUND))
-		{
-			CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_UPPER, ASPECT_RED);
-			if (CPInputStateGet(cpState, VOCC_M2W_ADJOIN))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_LOWER, ASPECT_RED);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M2W_APPROACH))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_LOWER, ASPECT_YELLOW);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M2W_APPROACH2))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_LOWER, ASPECT_FL_YELLOW);
-			} else {
-				CPSignalHeadSetAspect(cpState, SIG_MAIN1_E_LOWER, ASPECT_GREEN);
-			}
-		}
-		else if (CPRouteTest(cpState, ROUTE_MAIN2_TO_MAIN1_EASTBOUND))
-		{
-			CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_UPPER, ASPECT_RED);
-			if (CPInputStateGet(cpState, VOCC_M1E_ADJOIN))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_LOWER, ASPECT_RED);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M1E_APPROACH))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_LOWER, ASPECT_YELLOW);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M1E_APPROACH2))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_LOWER, ASPECT_FL_YELLOW);
-			} else {
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_W_LOWER, ASPECT_GREEN);
-			}
-		}
-		else if (CPRouteTest(cpState, ROUTE_MAIN2_TO_MAIN3_WESTBOUND))
-		{
-			CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_UPPER, ASPECT_RED);
-			if (CPInputStateGet(cpState, VOCC_M3W_ADJOIN))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_LOWER, ASPECT_RED);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M3W_APPROACH))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_LOWER, ASPECT_YELLOW);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M3W_APPROACH2))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_LOWER, ASPECT_FL_YELLOW);
-			} else {
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_LOWER, ASPECT_GREEN);
-			}
-		}
-		else if (CPRouteTest(cpState, ROUTE_MAIN3_TO_MAIN2_EASTBOUND))
-		{
-			CPSignalHeadSetAspect(cpState, SIG_MAIN3_W_UPPER, ASPECT_RED);
-			if (CPInputStateGet(cpState, VOCC_M2E_ADJOIN))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN3_W_LOWER, ASPECT_RED);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN3_W_LOWER, ASPECT_YELLOW);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M2E_APPROACH2))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN3_W_LOWER, ASPECT_FL_YELLOW);
-			} else {
-				CPSignalHeadSetAspect(cpState, SIG_MAIN3_W_LOWER, ASPECT_GREEN);
-			}
-		}
-		else if (CPRouteTest(cpState, ROUTE_MAIN2_TO_MAIN1_WESTBOUND))
-		{
-			CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_UPPER, ASPECT_RED);
-			if (CPInputStateGet(cpState, VOCC_M1W_ADJOIN))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_LOWER, ASPECT_RED);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M1W_APPROACH))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_LOWER, ASPECT_YELLOW);
-			}
-			else if (CPInputStateGet(cpState, VOCC_M1W_APPROACH2))
-			{
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_LOWER, ASPECT_FL_YELLOW);
-			} else {
-				CPSignalHeadSetAspect(cpState, SIG_MAIN2_E_LOWER, ASPECT_GREEN);
-			}
-		}
+	// First, if we have occupancy, drop any routes affected
+	for (i=0; i<CP_ROUTE_DEFS; i++)
+	{
+		if (osOccupied & pgm_read_dword(&cpRouteDefs[i].osInputs))
+			dropRoutes |= ROUTE_MASK(pgm_read_byte(&cpRouteDefs[i].route));
+		lockedTurnouts |= pgm_read_byte(&cpRouteDefs[i].lockTurnouts);
+	}
+	CPRouteMaskClear(cpState, dropRoutes);
+
+	// Now, unlock appropriate turnouts if no routes are set and there's no occupancy
+	if (!osOccupied && CPRouteNoneSet(cpState))
+	{
+		cpTurnoutsLockSet(cpState, lockedTurnouts, false);
 	}
+}
 
+static inline void vitalLogic(CPState_t *cpState)
+{
+	SignalHeadAspect_t aspects[SIG_END];
+	uint8_t i;
 
+	vitalLogicRoutes(cpState);
 
+	// Aspects are worked out here and only committed to cpState at the end,
+	//  so heads that don't actually change don't get marked dirty
+	vitalLogicAspects(cpState, aspects);
 
+	for(i=0; i<SIG_END; i++)
+		CPSignalHeadSetAspect(cpState, i, aspects[i]);
 }
 
 void setTimelockLED(XIOControl* xio, bool state)
 {
-	xioSetDeferredIObyPortBit(&xio[0], XIO_PORT_D, 6, state);
+	CPMiscOutputSet(xio, MISC_TIMELOCK_LED, state);
 }
 
 
@@ -656,116 +496,151 @@ uint8_t SignalHeadsToVirtOcc(SignalHeadAspect_t upperHead, SignalHeadAspect_t lo
 }
 
 
-uint8_t cpStateToStatusPacket(CPState_t* cpState, uint8_t *mrbTxBuffer, uint8_t mrbTxBufferSz)
-{
-	memset(mrbTxBuffer, 0, mrbTxBufferSz);
-	
-	mrbTxBuffer[MRBUS_PKT_SRC] = mrbus_dev_addr;
-	mrbTxBuffer[MRBUS_PKT_DEST] = 0xFF;
-	mrbTxBuffer[MRBUS_PKT_LEN] = 12;
-	mrbTxBuffer[5] = 'S';
-	
-	// Byte 6 - Occupancy & Entrance Signals
-	if (CPInputStateGet(cpState, VOCC_M1_OS))
-		mrbTxBuffer[6] |= MRB_STATUS6_MAIN1_OS_OCC;
-
-	if (CPInputStateGet(cpState, VOCC_M2_OS))
-		mrbTxBuffer[6] |= MRB_STATUS6_MAIN2_OS_OCC;
-
-	if (CPRouteTest(cpState, ROUTE_MAIN1_WESTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN1_TO_MAIN2_WESTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN1_TO_MAIN3_WESTBOUND))
-		mrbTxBuffer[6] |= MRB_STATUS6_M1E_ENTR_CLEARED;
-
-	if (CPRouteTest(cpState, ROUTE_MAIN1_EASTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN1_TO_MAIN2_EASTBOUND))
-		mrbTxBuffer[6] |= MRB_STATUS6_M1W_ENTR_CLEARED;
+// Status bytes and the parts of CPState_t they're built from
+#define STATUS_BYTE6_DIRTY        (CP_DIRTY_INPUTS | CP_DIRTY_ROUTES)
+#define STATUS_BYTE7_8_DIRTY      (CP_DIRTY_TIMELOCKS | CP_DIRTY_TURNOUTS)
+#define STATUS_BYTE9_11_DIRTY     (CP_DIRTY_SIGNALS | CP_DIRTY_ROUTES)
 
-	if (CPRouteTest(cpState, ROUTE_MAIN2_WESTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN2_TO_MAIN1_WESTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN2_VIA_MAIN1_WESTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN2_TO_MAIN3_WESTBOUND))
-		mrbTxBuffer[6] |= MRB_STATUS6_M2E_ENTR_CLEARED;
-
-	if (CPRouteTest(cpState, ROUTE_MAIN2_EASTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN2_TO_MAIN1_EASTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN2_VIA_MAIN1_EASTBOUND))
-		mrbTxBuffer[6] |= MRB_STATUS6_M2W_ENTR_CLEARED;
+// Stores a status packet byte, returning true if that changed it
+static inline bool statusByteUpdate(uint8_t *mrbTxBuffer, uint8_t idx, uint8_t value)
+{
+	bool changed = (mrbTxBuffer[idx] != value);
+	mrbTxBuffer[idx] = value;
+	return changed;
+}
 
-	if (CPRouteTest(cpState, ROUTE_MAIN3_TO_MAIN1_EASTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN3_TO_MAIN2_EASTBOUND))
-		mrbTxBuffer[6] |= MRB_STATUS6_M3W_ENTR_CLEARED;
+// Re-encodes only the status bytes affected by the dirty bits passed in - the
+//  rest of mrbTxBuffer is assumed to still hold the last status packet.
+//  Returns true if the packet came out any different from before.
+bool cpStateToStatusPacket(CPState_t* cpState, uint8_t *mrbTxBuffer, uint8_t dirty)
+{
+	bool changed = false;
 
+	changed |= statusByteUpdate(mrbTxBuffer, MRBUS_PKT_SRC, mrbus_dev_addr);
+	changed |= statusByteUpdate(mrbTxBuffer, MRBUS_PKT_DEST, 0xFF);
+	changed |= statusByteUpdate(mrbTxBuffer, MRBUS_PKT_LEN, 12);
+	changed |= statusByteUpdate(mrbTxBuffer, 5, 'S');
+	
+	if (dirty & STATUS_BYTE6_DIRTY)
+	{
+		// Byte 6 - Occupancy & Entrance Signals
+		uint8_t status6 = 0;
 
+		if (CPInputStateGet(cpState, VOCC_M1_OS))
+			status6 |= MRB_STATUS6_MAIN1_OS_OCC;
 
-	// Byte 7 - More turnout states
-	if (STATE_LOCKED != CPTimelockStateGet(cpState, MAIN_TIMELOCK))
-	{
-		mrbTxBuffer[7] |= MRB_STATUS7_E_XOVER_MANUAL | MRB_STATUS7_W_XOVER_MANUAL;
-		mrbTxBuffer[8] |= MRB_STATUS8_M1M3_MANUAL;
-	}
+		if (CPInputStateGet(cpState, VOCC_M2_OS))
+			status6 |= MRB_STATUS6_MAIN2_OS_OCC;
 
-	if (CPTurnoutActualDirectionGet(cpState, TURNOUT_E_XOVER))
-		mrbTxBuffer[7] |= MRB_STATUS7_E_XOVER_NORMAL;
-	else
-		mrbTxBuffer[7] |= MRB_STATUS7_E_XOVER_REVERSE;
+		if (CPRouteAnySet(cpState, ROUTE_MASK(ROUTE_MAIN1_WESTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN1_TO_MAIN2_WESTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN1_TO_MAIN3_WESTBOUND)))
+			status6 |= MRB_STATUS6_M1E_ENTR_CLEARED;
 
-	if (CPTurnoutLockGet(cpState, TURNOUT_E_XOVER))
-		mrbTxBuffer[7] |= MRB_STATUS7_E_XOVER_LOCK;
+		if (CPRouteAnySet(cpState, ROUTE_MASK(ROUTE_MAIN1_EASTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN1_TO_MAIN2_EASTBOUND)))
+			status6 |= MRB_STATUS6_M1W_ENTR_CLEARED;
 
-	if (CPTurnoutActualDirectionGet(cpState, TURNOUT_W_XOVER))
-		mrbTxBuffer[7] |= MRB_STATUS7_W_XOVER_NORMAL;
-	else
-		mrbTxBuffer[7] |= MRB_STATUS7_W_XOVER_REVERSE;
+		if (CPRouteAnySet(cpState, ROUTE_MASK(ROUTE_MAIN2_WESTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN2_TO_MAIN1_WESTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN2_VIA_MAIN1_WESTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN2_TO_MAIN3_WESTBOUND)))
+			status6 |= MRB_STATUS6_M2E_ENTR_CLEARED;
 
-	if (CPTurnoutLockGet(cpState, TURNOUT_W_XOVER))
-		mrbTxBuffer[7] |= MRB_STATUS7_W_XOVER_LOCK;
+		if (CPRouteAnySet(cpState, ROUTE_MASK(ROUTE_MAIN2_EASTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN2_TO_MAIN1_EASTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN2_VIA_MAIN1_EASTBOUND)))
+			status6 |= MRB_STATUS6_M2W_ENTR_CLEARED;
 
-	// Byte 8 - More turnout states
-	if (CPTurnoutActualDirectionGet(cpState, TURNOUT_M1_M3))
-		mrbTxBuffer[8] |= MRB_STATUS8_M1M3_NORMAL;
-	else
-		mrbTxBuffer[8] |= MRB_STATUS8_M1M3_REVERSE;
+		if (CPRouteAnySet(cpState, ROUTE_MASK(ROUTE_MAIN3_TO_MAIN1_EASTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN3_TO_MAIN2_EASTBOUND)))
+			status6 |= MRB_STATUS6_M3W_ENTR_CLEARED;
 
-	if (CPTurnoutLockGet(cpState, TURNOUT_M1_M3))
-		mrbTxBuffer[8] |= MRB_STATUS8_M1M3_LOCK;
+		changed |= statusByteUpdate(mrbTxBuffer, 6, status6);
+	}
 
+	if (dirty & STATUS_BYTE7_8_DIRTY)
+	{
+		// Byte 7 - More turnout states
+		uint8_t status7 = 0;
+		uint8_t status8 = 0;
 
-	// Compute virtual occupancy
-	mrbTxBuffer[9] = SignalHeadsToVirtOcc(CPSignalHeadGetAspect(cpState, SIG_MAIN1_E_UPPER), CPSignalHeadGetAspect(cpState, SIG_MAIN1_E_LOWER))
-		| (SignalHeadsToVirtOcc(CPSignalHeadGetAspect(cpState, SIG_MAIN1_W_UPPER), CPSignalHeadGetAspect(cpState, SIG_MAIN1_W_LOWER))<<4);
+		if (STATE_LOCKED != CPTimelockStateGet(cpState, MAIN_TIMELOCK))
+		{
+			status7 |= MRB_STATUS7_E_XOVER_MANUAL | MRB_STATUS7_W_XOVER_MANUAL;
+			status8 |= MRB_STATUS8_M1M3_MANUAL;
+		}
 
-	if (CPRouteTest(cpState, ROUTE_MAIN1_WESTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN2_TO_MAIN1_WESTBOUND))
-		mrbTxBuffer[9] |= MRB_STATUS9_M1W_VIRT_TUMBLE;
+		if (CPTurnoutActualDirectionGet(cpState, TURNOUT_E_XOVER))
+			status7 |= MRB_STATUS7_E_XOVER_NORMAL;
+		else
+			status7 |= MRB_STATUS7_E_XOVER_REVERSE;
 
-	if (CPRouteTest(cpState, ROUTE_MAIN1_EASTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN2_TO_MAIN1_EASTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN3_TO_MAIN1_EASTBOUND))
-		mrbTxBuffer[9] |= MRB_STATUS9_M1E_VIRT_TUMBLE;
+		if (CPTurnoutLockGet(cpState, TURNOUT_E_XOVER))
+			status7 |= MRB_STATUS7_E_XOVER_LOCK;
 
-	mrbTxBuffer[10] = SignalHeadsToVirtOcc(CPSignalHeadGetAspect(cpState, SIG_MAIN2_E_UPPER), CPSignalHeadGetAspect(cpState, SIG_MAIN2_E_LOWER))
-		| (SignalHeadsToVirtOcc(CPSignalHeadGetAspect(cpState, SIG_MAIN2_W_UPPER), CPSignalHeadGetAspect(cpState, SIG_MAIN2_W_LOWER))<<4);
+		if (CPTurnoutActualDirectionGet(cpState, TURNOUT_W_XOVER))
+			status7 |= MRB_STATUS7_W_XOVER_NORMAL;
+		else
+			status7 |= MRB_STATUS7_W_XOVER_REVERSE;
 
-	if (CPRouteTest(cpState, ROUTE_MAIN2_WESTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN2_VIA_MAIN1_WESTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN1_TO_MAIN2_WESTBOUND))
-		mrbTxBuffer[10] |= MRB_STATUS10_M2W_VIRT_TUMBLE;
+		if (CPTurnoutLockGet(cpState, TURNOUT_W_XOVER))
+			status7 |= MRB_STATUS7_W_XOVER_LOCK;
 
-	if (CPRouteTest(cpState, ROUTE_MAIN2_EASTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN2_VIA_MAIN1_EASTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN1_TO_MAIN2_EASTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN3_TO_MAIN2_EASTBOUND))
-		mrbTxBuffer[10] |= MRB_STATUS10_M2E_VIRT_TUMBLE;
+		// Byte 8 - More turnout states
+		if (CPTurnoutActualDirectionGet(cpState, TURNOUT_M1_M3))
+			status8 |= MRB_STATUS8_M1M3_NORMAL;
+		else
+			status8 |= MRB_STATUS8_M1M3_REVERSE;
 
-	mrbTxBuffer[11] = SignalHeadsToVirtOcc(CPSignalHeadGetAspect(cpState, SIG_MAIN3_W_UPPER), CPSignalHeadGetAspect(cpState, SIG_MAIN3_W_LOWER))<<4;
+		if (CPTurnoutLockGet(cpState, TURNOUT_M1_M3))
+			status8 |= MRB_STATUS8_M1M3_LOCK;
 
-	if (CPRouteTest(cpState, ROUTE_MAIN2_TO_MAIN3_WESTBOUND)
-		|| CPRouteTest(cpState, ROUTE_MAIN1_TO_MAIN3_WESTBOUND))
-		mrbTxBuffer[11] |= MRB_STATUS11_M3W_VIRT_TUMBLE;
+		changed |= statusByteUpdate(mrbTxBuffer, 7, status7);
+		changed |= statusByteUpdate(mrbTxBuffer, 8, status8);
+	}
 
-	return mrbTxBuffer[MRBUS_PKT_LEN];
+	if (dirty & STATUS_BYTE9_11_DIRTY)
+	{
+		// Compute virtual occupancy
+		uint8_t status9 = SignalHeadsToVirtOcc(CPSignalHeadGetAspect(cpState, SIG_MAIN1_E_UPPER), CPSignalHeadGetAspect(cpState, SIG_MAIN1_E_LOWER))
+			| (SignalHeadsToVirtOcc(CPSignalHeadGetAspect(cpState, SIG_MAIN1_W_UPPER), CPSignalHeadGetAspect(cpState, SIG_MAIN1_W_LOWER))<<4);
+
+		if (CPRouteAnySet(cpState, ROUTE_MASK(ROUTE_MAIN1_WESTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN2_TO_MAIN1_WESTBOUND)))
+			status9 |= MRB_STATUS9_M1W_VIRT_TUMBLE;
+
+		if (CPRouteAnySet(cpState, ROUTE_MASK(ROUTE_MAIN1_EASTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN2_TO_MAIN1_EASTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN3_TO_MAIN1_EASTBOUND)))
+			status9 |= MRB_STATUS9_M1E_VIRT_TUMBLE;
+
+		uint8_t status10 = SignalHeadsToVirtOcc(CPSignalHeadGetAspect(cpState, SIG_MAIN2_E_UPPER), CPSignalHeadGetAspect(cpState, SIG_MAIN2_E_LOWER))
+			| (SignalHeadsToVirtOcc(CPSignalHeadGetAspect(cpState, SIG_MAIN2_W_UPPER), CPSignalHeadGetAspect(cpState, SIG_MAIN2_W_LOWER))<<4);
+
+		if (CPRouteAnySet(cpState, ROUTE_MASK(ROUTE_MAIN2_WESTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN2_VIA_MAIN1_WESTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN1_TO_MAIN2_WESTBOUND)))
+			status10 |= MRB_STATUS10_M2W_VIRT_TUMBLE;
+
+		if (CPRouteAnySet(cpState, ROUTE_MASK(ROUTE_MAIN2_EASTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN2_VIA_MAIN1_EASTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN1_TO_MAIN2_EASTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN3_TO_MAIN2_EASTBOUND)))
+			status10 |= MRB_STATUS10_M2E_VIRT_TUMBLE;
+
+		uint8_t status11 = SignalHeadsToVirtOcc(CPSignalHeadGetAspect(cpState, SIG_MAIN3_W_UPPER), CPSignalHeadGetAspect(cpState, SIG_MAIN3_W_LOWER))<<4;
+
+		if (CPRouteAnySet(cpState, ROUTE_MASK(ROUTE_MAIN2_TO_MAIN3_WESTBOUND)
+			| ROUTE_MASK(ROUTE_MAIN1_TO_MAIN3_WESTBOUND)))
+			status11 |= MRB_STATUS11_M3W_VIRT_TUMBLE;
+
+		changed |= statusByteUpdate(mrbTxBuffer, 9, status9);
+		changed |= statusByteUpdate(mrbTxBuffer, 10, status10);
+		changed |= statusByteUpdate(mrbTxBuffer, 11, status11);
+	}
 
+	return changed;
 }
 
 bool cpSetTurnout(CPState_t* cpState, CPTurnoutNames_t turnout, bool setNormal)
@@ -773,7 +648,7 @@ bool cpSetTurnout(CPState_t* cpState, CPTurnoutNames_t turnout, bool setNormal)
 	if (STATE_LOCKED != CPTimelockStateGet(cpState, MAIN_TIMELOCK))
 		return false; // Can't set any turnout when the timelock is open
 
-	if (CPInputStateGet(cpState, VOCC_M1_OS) || CPInputStateGet(cpState, VOCC_M2_OS))
+	if (CPInputMaskGet(cpState) & CP_OS_INPUTS)
 		return false; // Can't set any turnout when the CP tracks are occupied
 		
 	if (CPTurnoutLockGet(cpState, turnout))
@@ -786,233 +661,60 @@ bool cpSetTurnout(CPState_t* cpState, CPTurnoutNames_t turnout, bool setNormal)
 
 bool cpClearRoute(CPState_t* cpState, CPRouteEntrance_t entrance)
 {
-	switch(entrance)
-	{
-		case ROUTE_ENTR_M1_EASTBOUND:
-			CPRouteClear(cpState, ROUTE_MAIN1_TO_MAIN2_EASTBOUND);
-			CPRouteClear(cpState, ROUTE_MAIN1_EASTBOUND);
-			break;
-
-		case ROUTE_ENTR_M1_WESTBOUND:
-			CPRouteClear(cpState, ROUTE_MAIN1_WESTBOUND);
-			CPRouteClear(cpState, ROUTE_MAIN1_TO_MAIN2_WESTBOUND);
-			CPRouteClear(cpState, ROUTE_MAIN1_TO_MAIN3_WESTBOUND);
-			break;
-
-		case ROUTE_ENTR_M2_EASTBOUND:
-			CPRouteClear(cpState, ROUTE_MAIN2_VIA_MAIN1_EASTBOUND);
-			CPRouteClear(cpState, ROUTE_MAIN2_TO_MAIN1_EASTBOUND);
-			CPRouteClear(cpState, ROUTE_MAIN2_EASTBOUND);
-			break;
-
-		case ROUTE_ENTR_M2_WESTBOUND:
-			CPRouteClear(cpState, ROUTE_MAIN2_VIA_MAIN1_WESTBOUND);
-			CPRouteClear(cpState, ROUTE_MAIN2_TO_MAIN1_WESTBOUND);
-			CPRouteClear(cpState, ROUTE_MAIN2_TO_MAIN3_WESTBOUND);
-			CPRouteClear(cpState, ROUTE_MAIN2_WESTBOUND);
-			break;
-		
-		case ROUTE_ENTR_M3_EASTBOUND:
-			CPRouteClear(cpState, ROUTE_MAIN3_TO_MAIN1_EASTBOUND);
-			CPRouteClear(cpState, ROUTE_MAIN3_TO_MAIN2_EASTBOUND);
-			break;
+	CPRouteMask_t routes = 0;
+	bool found = false;
 
-		default:
-			return false;
+	for (uint8_t i=0; i<CP_ROUTE_DEFS; i++)
+	{
+		if (entrance != pgm_read_byte(&cpRouteDefs[i].entrance))
+			continue;
+		routes |= ROUTE_MASK(pgm_read_byte(&cpRouteDefs[i].route));
+		found = true;
 	}
 
-	return true;
+	CPRouteMaskClear(cpState, routes);
+	return found;
 }
 
 
 
 bool cpCodeRoute(CPState_t* cpState, CPRouteEntrance_t entrance, bool setRoute)
 {
+	CPRouteDef_t def;
+
 	if (STATE_LOCKED != CPTimelockStateGet(cpState, MAIN_TIMELOCK))
 		return false; // Can't set any route when the timelock is open
 
 	if (false == setRoute)
 		return cpClearRoute(cpState, entrance);
 
-	bool eastCrossover = CPTurnoutRequestedDirectionGet(cpState, TURNOUT_E_XOVER);
-	bool westCrossover = CPTurnoutRequestedDirectionGet(cpState, TURNOUT_W_XOVER);
-	bool m1m3Switch = CPTurnoutRequestedDirectionGet(cpState, TURNOUT_M1_M3);
-	
 	// Remember, with turnouts normal = true
-
-	switch(entrance)
+	uint8_t requestedNormal = 0;
+	for (uint8_t i=0; i<TURNOUT_END; i++)
 	{
-		case ROUTE_ENTR_M3_EASTBOUND:
-			if (!westCrossover || m1m3Switch) // Turnout set against us
-				return false;
-				
-			if (eastCrossover)
-			{
-				// Both crossovers normal, straight through route
-				// Is there already a conflicting route set?
-				if (CPRouteTest(cpState, ROUTE_MAIN1_TO_MAIN3_WESTBOUND))
-					return false;
-
-				// Lock turnouts
-				cpLockAllTurnouts(cpState);
-				// Set route
-				CPRouteSet(cpState, ROUTE_MAIN3_TO_MAIN1_EASTBOUND);
-			} else {
-				// West crossover reversed, M1->M2
-				if (CPRouteTest(cpState, ROUTE_MAIN2_TO_MAIN3_WESTBOUND)) 
-					return false;
-
-				// Lock turnouts
-				cpLockAllTurnouts(cpState);
-				CPRouteSet(cpState, ROUTE_MAIN3_TO_MAIN2_EASTBOUND);
-			}
-			break;
-		
-		case ROUTE_ENTR_M1_EASTBOUND:
-			if (!westCrossover || !m1m3Switch) // Turnout set against us
-				return false;
-
-			if (eastCrossover)
-			{
-				// Both crossovers normal, straight through route
-				// Is there already a conflicting route set?
-				if (CPRouteTest(cpState, ROUTE_MAIN1_WESTBOUND))
-					return false;
-
-				// Lock turnouts
-				cpLockAllTurnouts(cpState);
-				// Set route
-				CPRouteSet(cpState, ROUTE_MAIN1_EASTBOUND);
-			} else {
-				// West crossover reversed, M1->M2
-				if (CPRouteTest(cpState, ROUTE_MAIN2_TO_MAIN1_WESTBOUND))
-					return false;
+		if (CPTurnoutRequestedDirectionGet(cpState, i))
+			requestedNormal |= TURNOUT_MASK(i);
+	}
 
-				// Lock turnouts
-				cpLockAllTurnouts(cpState);
-				CPRouteSet(cpState, ROUTE_MAIN1_TO_MAIN2_EASTBOUND);
-			}
-			break;
-			
-			
-		case ROUTE_ENTR_M1_WESTBOUND:
-			if (!eastCrossover) // Turnout set against us
-				return false;
-				
-			if (westCrossover)
-			{
-				// Both crossovers normal, straight through route
+	// The first route from this entrance that the turnouts line is the one
+	for (uint8_t i=0; i<CP_ROUTE_DEFS; i++)
+	{
+		if (entrance != pgm_read_byte(&cpRouteDefs[i].entrance))
+			continue;
 
-				if (m1m3Switch)
-				{
-					// Is there already a conflicting route set?
-					if (CPRouteTest(cpState, ROUTE_MAIN1_EASTBOUND))
-						return false;
-
-					// Lock turnouts
-					cpLockAllTurnouts(cpState);
-					// Set route
-					CPRouteSet(cpState, ROUTE_MAIN1_WESTBOUND);
-				} else {
-					// M1 to M3 switch is reversed
-					// Is there already a conflicting route set?
-					if (CPRouteTest(cpState, ROUTE_MAIN3_TO_MAIN1_EASTBOUND))
-						return false;
-					// Lock turnouts
-					cpLockAllTurnouts(cpState);
-					// Set route
-					CPRouteSet(cpState, ROUTE_MAIN1_TO_MAIN3_WESTBOUND);
-				}
-			} else {
-				// West crossover reversed, M1->M2
-				if (CPRouteTest(cpState, ROUTE_MAIN2_TO_MAIN1_EASTBOUND))
-					return false;
+		memcpy_P(&def, &cpRouteDefs[i], sizeof(CPRouteDef_t));
+		if ((def.turnoutsNormal & ~requestedNormal) || (def.turnoutsReversed & requestedNormal))
+			continue; // Turnout set against us
 
-				CPRouteSet(cpState, ROUTE_MAIN1_TO_MAIN2_WESTBOUND);
-			}
-			break;
-		
-		case ROUTE_ENTR_M2_EASTBOUND:
-			if (!eastCrossover && !westCrossover)
-			{
-				// Main 2 -> Main 2 via Main 1 - icky
-				if (CPRouteTest(cpState, ROUTE_MAIN2_VIA_MAIN1_WESTBOUND))
-					return false;
+		// Is there already a conflicting route set?
+		if (CPRouteAnySet(cpState, def.conflicts))
+			return false;
 
-				cpLockAllTurnouts(cpState);
-				CPRouteSet(cpState, ROUTE_MAIN2_VIA_MAIN1_EASTBOUND);
-				
-			} else if (eastCrossover && westCrossover) {
-				// Both crossovers normal, straight through route
-				// Is there already a conflicting route set?
-				if (CPRouteTest(cpState, ROUTE_MAIN2_WESTBOUND))
-					return false;
-
-				// Set route
-				cpLockAllTurnouts(cpState);
-				CPRouteSet(cpState, ROUTE_MAIN2_EASTBOUND);
-				return true;
-			} else if (!westCrossover && eastCrossover) {
-				// West crossover reversed, M2->M1
-				if (CPRouteTest(cpState, ROUTE_MAIN1_TO_MAIN2_WESTBOUND))
-					return false;
-
-				cpLockAllTurnouts(cpState);
-				CPRouteSet(cpState, ROUTE_MAIN2_TO_MAIN1_EASTBOUND);
-				return true;
-			} else {
-				return false;
-			}
-			break;
-			
-			
-		case ROUTE_ENTR_M2_WESTBOUND:
-			if (!eastCrossover && !westCrossover)
-			{
-				// Main 2 -> Main 2 via Main 1 - icky
-				if (CPRouteTest(cpState, ROUTE_MAIN2_VIA_MAIN1_EASTBOUND))
-					return false;
-					
-				cpLockAllTurnouts(cpState);
-				CPRouteSet(cpState, ROUTE_MAIN2_VIA_MAIN1_WESTBOUND);
-				return true;
-			} else if (eastCrossover && westCrossover) {
-				// Both crossovers normal, straight through route
-				// Is there already a conflicting route set?
-				if (CPRouteTest(cpState, ROUTE_MAIN2_EASTBOUND))
-					return false;
-
-				// Set route
-				cpLockAllTurnouts(cpState);
-				CPRouteSet(cpState, ROUTE_MAIN2_WESTBOUND);
-				return true;
-			} else if (westCrossover && !eastCrossover) {
-
-				if (m1m3Switch)
-				{
-					// West crossover reversed, M2->M1
-					if (CPRouteTest(cpState, ROUTE_MAIN1_TO_MAIN2_EASTBOUND))
-						return false;
-
-					cpLockAllTurnouts(cpState);
-					CPRouteSet(cpState, ROUTE_MAIN2_TO_MAIN1_WESTBOUND);
-				} else {
-					if (CPRouteTest(cpState, ROUTE_MAIN3_TO_MAIN2_EASTBOUND))
-						return false;
-
-					cpLockAllTurnouts(cpState);
-					CPRouteSet(cpState, ROUTE_MAIN2_TO_MAIN3_WESTBOUND);
-				}
-				return true;
-			} else {
-				return false;
-			}
-			break;
-			
-		default:
-			break;
+		cpTurnoutsLockSet(cpState, def.lockTurnouts, true);
+		CPRouteSet(cpState, def.route);
+		return true;
 	}
-	
+
 	return false;
 }
 
@@ -1107,18 +809,31 @@ void cpHandleTurnouts(CPState_t* state, XIOControl* xio)
 int main(void)
 {
 	CPState_t cpState;
-	XIOControl xio[2];
+	XIOControl xio[CP_XIO_COUNT];
 	bool changed = false;
+	uint8_t xioRefreshCounter = 0;
+	uint8_t xioRefreshIndex = CP_XIO_COUNT;
+	uint8_t inputPollCounter = 0;
 	uint8_t update_decisecs = 20;
-	uint8_t lastStatusPacket[MRBUS_BUFFER_SIZE];
 	uint8_t mrbTxBuffer[MRBUS_BUFFER_SIZE];
+	uint8_t statusDirty = 0;
+	bool runLogic = true;
+	bool outputsInFlight = false;
+	bool inputReadsPending = false;   // XIO queue was full - retry these next pass
+	bool outputWritesPending = false;
 	// Application initialization
 	init();
 
+	memset(mrbTxBuffer, 0, sizeof(mrbTxBuffer));
+
 	CPInitialize(&cpState);
 
 	// Initialize a 100 Hz timer. 
 	initialize100HzTimer();
+	initializeXioInterrupt();
+	timestampInit();
+	latencyReset();
+	PROFILE_RESET();
 
 	// Initialize MRBus core
 	mrbusPktQueueInitialize(&mrbusTxQueue, mrbusTxPktBufferArray, txBuffer_DEPTH);
@@ -1131,20 +846,25 @@ int main(void)
 	i2c_master_init();
 	xioHardwareReset();
 
-	// For the XIO pins, 0 is output, 1 is input
-	const uint8_t const xio0PinDirection[5] = { 0x00, 0x00, 0x00, 0x80, 0x00 };
-	const uint8_t const xio1PinDirection[5] = { 0xF8, 0x01, 0x00, 0x00, 0x00 };
+	initializeXios(xio);
+	configureXioDebounce(xio, &cpState);
 
+	set_sleep_mode(SLEEP_MODE_IDLE);
 
-	xioInitialize(&xio[0], I2C_XIO0_ADDRESS, xio0PinDirection);
-	xioInitialize(&xio[1], I2C_XIO1_ADDRESS, xio1PinDirection);
 	while (1)
 	{
 		wdt_reset();
+		PROFILE_START(PROFILE_LOOP);
 
-		// Handle any packets that may have come in
+		// Handle whatever packets have come in, all at once
+		//  Anything they change in cpState shows up as dirty bits, so the logic
+		//  below runs once for the whole batch rather than once per packet
 		if (mrbusPktQueueDepth(&mrbusRxQueue))
-			PktHandler(&cpState);
+		{
+			PROFILE_START(PROFILE_PKT_HANDLER);
+			RxQueueDrain(&cpState);
+			PROFILE_STOP(PROFILE_PKT_HANDLER);
+		}
 
 		// The EVENT_I2C_ERROR flag gets set if a read or write fails for some reason
 		// I'm going to assume it's because the I2C bus went heywire, and we need to do
@@ -1153,11 +873,12 @@ int main(void)
 		if (events & EVENT_I2C_ERROR)
 		{
 			i2cResetCounter++;
+			xioFlush();
 			xioHardwareReset();
-			xioInitialize(&xio[0], I2C_XIO0_ADDRESS, xio0PinDirection);
-			xioInitialize(&xio[1], I2C_XIO1_ADDRESS, xio1PinDirection);
+			bool allInitialized = initializeXios(xio);
+			configureXioDebounce(xio, &cpState);
 
-			if (xioIsInitialized(&xio[0]) && xioIsInitialized(&xio[1]))
+			if (allInitialized)
 				events &= ~(EVENT_I2C_ERROR); // If we initialized successfully, clear error
 		}
 
@@ -1165,54 +886,165 @@ int main(void)
 		{
 			events &= ~(EVENT_1HZ);
 			CPTimelockApply1HzTick(&cpState);
+			runLogic = true;  // Timelock countdown
+
+			if (++xioRefreshCounter >= xioRefreshTime)
+			{
+				// Refreshed one per output write below so they don't all go at once
+				xioRefreshCounter = 0;
+				xioRefreshIndex = 0;
+			}
+		}
+
+		if (events & EVENT_XIO_CONFIG)
+		{
+			events &= ~(EVENT_XIO_CONFIG);
+			configureXioDebounce(xio, &cpState);
+		}
+
+		if (events & EVENT_XIO_IRQ)
+		{
+			// An input changed - go get it now rather than waiting on the next tick
+			uint32_t irqTimestamp;
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+			{
+				events &= ~(EVENT_XIO_IRQ);
+				irqTimestamp = xioIrqTimestamp;
+			}
+			latencyInputEdge(irqTimestamp);
+			inputReadsPending = !queueXioInputReads(xio);
 		}
 
 		if(events & (EVENT_READ_INPUTS))
 		{
-			// Read local  and hardware inputs
+			// Queue up reads of local and hardware inputs if anybody needs them
 			events &= ~(EVENT_READ_INPUTS);
-			xioInputRead(&xio[0]);
-			xioInputRead(&xio[1]);
-			CPXIOInputFilter(&cpState, xio);
+			if (++inputPollCounter >= XIO_INPUT_POLL_TICKS)
+				inputPollCounter = 0;
+
+			if (xioIrqAsserted() || xioAnyDebounceInProgress(xio))
+				inputReadsPending = !queueXioInputReads(xio);
+			else if (inputPollCounter < CP_XIO_COUNT && xioHasInputs(&xio[inputPollCounter])
+				&& !xioQueueInputRead(&xio[inputPollCounter]))
+				inputReadsPending = true;
+		}
+		else if (inputReadsPending)
+			inputReadsPending = !queueXioInputReads(xio);
+
+		// Move any queued XIO transactions along - this never waits on the bus
+		PROFILE_START(PROFILE_XIO_PROCESS);
+		if (xioProcess() & XIO_COMPLETE_INPUTS_READ)
+			events |= EVENT_INPUTS_UPDATED;
+		PROFILE_STOP(PROFILE_XIO_PROCESS);
+
+		if (events & EVENT_INPUTS_UPDATED)
+		{
+			events &= ~(EVENT_INPUTS_UPDATED);
+			PROFILE_START(PROFILE_INPUT_FILTER);
+			bool inputsChanged = CPXIOInputFilter(&cpState, xio);
+			PROFILE_STOP(PROFILE_INPUT_FILTER);
+			latencyInputDebounced(inputsChanged, xioAnyDebounceInProgress(xio));
 		}
 
-		// Vital Logic
-		cpHandleTurnouts(&cpState, xio);
-		vitalLogic(&cpState);
+		// The timelock LED blinks along with EVENT_BLINKY, so catch it up before outputs go
+		if (events & EVENT_WRITE_OUTPUTS)
+			runLogic = true;
+
+		// Vital Logic - only runs when something it depends on has changed
+		if (runLogic || cpState.dirty)
+		{
+			uint8_t settlePasses = 0;
+			uint8_t logicDirty = 0;
+
+			do
+			{
+				logicDirty |= CPStateDirtyTake(&cpState);
+				PROFILE_START(PROFILE_TURNOUTS);
+				cpHandleTurnouts(&cpState, xio);
+				PROFILE_STOP(PROFILE_TURNOUTS);
+				PROFILE_START(PROFILE_VITAL_LOGIC);
+				vitalLogic(&cpState);
+				PROFILE_STOP(PROFILE_VITAL_LOGIC);
+			} while (cpState.dirty && ++settlePasses < VITAL_LOGIC_SETTLE_PASSES);
+			runLogic = false;
+
+			latencyLogicDone(0 != ((logicDirty | cpState.dirty) & (CP_DIRTY_SIGNALS | CP_DIRTY_TURNOUTS)));
+			statusDirty |= logicDirty;
+		}
 
 		// Send output
 		if (events & EVENT_WRITE_OUTPUTS)
 		{
+			PROFILE_START(PROFILE_OUTPUTS);
 			CPSignalsToOutputs(&cpState, xio, events & EVENT_BLINKY);
 			CPTurnoutsToOutputs(&cpState, xio);
-			xioOutputWrite(&xio[0]);
-			xioOutputWrite(&xio[1]);
+			if (xioRefreshIndex < CP_XIO_COUNT)
+				xioForceRefresh(&xio[xioRefreshIndex++]);
+			outputWritesPending = !queueXioOutputWrites(xio);
+			PROFILE_STOP(PROFILE_OUTPUTS);
+			latencyOutputsQueued();
+			outputsInFlight = true;
 
 			events &= ~(EVENT_WRITE_OUTPUTS);
 		}
+		else if (CPOutputsExpedited(&cpState))
+		{
+			// Something went more restrictive or a turnout was thrown - that goes out
+			//  now rather than on the next regular write, in the same blink phase
+			PROFILE_START(PROFILE_OUTPUTS);
+			CPExpeditedToOutputs(&cpState, xio, events & EVENT_BLINKY);
+			outputWritesPending = !queueXioOutputWrites(xio);
+			PROFILE_STOP(PROFILE_OUTPUTS);
+			latencyOutputsQueued();
+			outputsInFlight = true;
+		}
+		else if (outputWritesPending)
+		{
+			// The XIO queue was full - the outputs are already set up, they
+			//  just need queueing again
+			outputWritesPending = !queueXioOutputWrites(xio);
+		}
+
+		if (outputsInFlight && !xioBusy())
+		{
+			// Everything from the last output write is out on the pins
+			latencyOutputsCommitted();
+			outputsInFlight = false;
+		}
 		
-		uint8_t statusLen = cpStateToStatusPacket(&cpState, mrbTxBuffer, sizeof(mrbTxBuffer));
-		
-		if (0 != memcmp(mrbTxBuffer, lastStatusPacket, statusLen))
+		// Only rebuild the status packet when something it depends on changed
+		//  Anything still dirty in cpState gets another trip through the logic first
+		if (statusDirty)
 		{
-			memset(lastStatusPacket, 0, sizeof(lastStatusPacket));
-			memcpy(lastStatusPacket, mrbTxBuffer, statusLen);
-			changed = true;
+			PROFILE_START(PROFILE_STATUS_PACKET);
+			if (cpStateToStatusPacket(&cpState, mrbTxBuffer, statusDirty))
+				changed = true;
+			PROFILE_STOP(PROFILE_STATUS_PACKET);
+			statusDirty = 0;
 		}
 		if(decisecs >= update_decisecs)
 			changed = true;
 
+		// mrbTxBuffer holds the status packet between passes, so it gets copied
+		//  into a transmit slot.  If there isn't one, try again next pass.
 		if (changed)
 		{
-			mrbusPktQueuePush(&mrbusTxQueue, mrbTxBuffer, statusLen);
-			decisecs = 0;
-			changed = false;
+			uint8_t* statusPkt = pktQueueReserve(&mrbusTxQueue);
+			if (NULL != statusPkt)
+			{
+				memcpy(statusPkt, mrbTxBuffer, mrbTxBuffer[MRBUS_PKT_LEN]);
+				pktQueueCommit(&mrbusTxQueue);
+				decisecs = 0;
+				changed = false;
+			}
 		}
 
 		// If we have a packet to be transmitted, try to send it here
 		if (mrbusPktQueueDepth(&mrbusTxQueue))
 		{
+			PROFILE_START(PROFILE_TRANSMIT);
 			uint8_t fail = mrbusTransmit();
+			PROFILE_STOP(PROFILE_TRANSMIT);
 
 			// If we're here, we failed to start transmission due to somebody else transmitting
 			// Given that our transmit buffer is full, priority one should be getting that data onto
@@ -1231,21 +1063,202 @@ int main(void)
 					wdt_reset();
 					_delay_ms(1);
 					if (mrbusPktQueueDepth(&mrbusRxQueue))
-						PktHandler(&cpState);
+						RxQueueDrain(&cpState);
 				}
 			}
 		}
+
+		PROFILE_STOP(PROFILE_LOOP);
+
+		// Nothing left to do until an interrupt brings something new - idle the CPU.
+		//  Timer, MRBus, TWI, and XIO pin change interrupts all wake it back up.
+		//  Checked with interrupts off so nothing can sneak in between the check
+		//  and the sleep; sei() always lets the following instruction run first.
+		cli();
+		if (0 == (events & EVENT_PENDING_MASK)
+			&& !runLogic && !cpState.dirty && !changed && !inputReadsPending && !outputWritesPending
+			&& !(xioBusy() && !i2c_busy())
+			&& 0 == mrbusPktQueueDepth(&mrbusRxQueue)
+			&& 0 == mrbusPktQueueDepth(&mrbusTxQueue))
+		{
+			sleep_enable();
+			sei();
+			sleep_cpu();
+			sleep_disable();
+		}
+		sei();
 	}
 }
 
-void PktHandler(CPState_t *cpState)
+// Receive interest filter - the MRBus receive interrupt hands every packet to
+//  mrbusPktQueuePush().  The mrbus library has no hook for this, so the push is
+//  wrapped at link time (-Wl,--wrap in the Makefile) and packets PktHandler()
+//  would only throw away never take up a receive queue slot.  This runs in the
+//  receive interrupt, so keep it short.
+//  Keep this in step with the packet filter and command types below.
+typedef struct
+{
+	uint32_t accepted;  // Queued for PktHandler()
+	uint32_t dropped;
+} RxFilterStats_t;
+
+static volatile RxFilterStats_t rxFilterStats;
+
+static bool rxFilterInterested(const uint8_t* pkt)
+{
+	// Loopback - we sent it
+	if (pkt[MRBUS_PKT_SRC] == mrbus_dev_addr)
+		return false;
+
+	// Not for us and not broadcast
+	if (0xFF != pkt[MRBUS_PKT_DEST] && mrbus_dev_addr != pkt[MRBUS_PKT_DEST])
+		return false;
+
+	switch(pkt[MRBUS_PKT_TYPE])
+	{
+		case 'A':
+		case 'C':
+		case 'W':
+		case 'R':
+		case 'V':
+		case 'D':
+		case 'X':
+			return true;
+	}
+
+	// Everything else only matters if a bit/byte rule is listening for it
+	return CPMRBusVirtInputInterested(pkt[MRBUS_PKT_SRC], pkt[MRBUS_PKT_TYPE]);
+}
+
+// Receive queue sizing evidence - how deep the queue has gotten, how many
+//  packets were lost to it being full, and how the drain keeps up.  The first
+//  two are counted in the push wrapper below, as each packet arrives.
+typedef struct
+{
+	uint32_t overflows;     // Interesting packets lost to a full queue
+	uint16_t budgetCutoffs; // Drains stopped by the time budget, pins at 0xFFFF
+	uint8_t highWater;      // Deepest the queue has been
+	uint8_t maxBatch;       // Most packets handled in one drain
+} RxQueueStats_t;
+
+static volatile RxQueueStats_t rxQueueStats;
+
+// --wrap only swaps symbols, so nothing checks these against the library's
+//  prototype unless we do
+bool __real_mrbusPktQueuePush(MRBusPktQueue* q, uint8_t* data, uint8_t dataLen);
+bool __wrap_mrbusPktQueuePush(MRBusPktQueue* q, uint8_t* data, uint8_t dataLen);
+
+typedef char RxFilterWrapType_t[__builtin_types_compatible_p(__typeof__(&mrbusPktQueuePush), __typeof__(&__wrap_mrbusPktQueuePush)) ? 1 : -1];
+typedef char RxFilterRealType_t[__builtin_types_compatible_p(__typeof__(&mrbusPktQueuePush), __typeof__(&__real_mrbusPktQueuePush)) ? 1 : -1];
+
+bool __wrap_mrbusPktQueuePush(MRBusPktQueue* q, uint8_t* data, uint8_t dataLen)
+{
+	if (&mrbusRxQueue == q)
+	{
+		uint8_t depth;
+
+		if (dataLen <= MRBUS_PKT_TYPE || !rxFilterInterested(data))
+		{
+			rxFilterStats.dropped++;
+			return true;  // As far as the receiver's concerned, it's been taken care of
+		}
+		if (!__real_mrbusPktQueuePush(q, data, dataLen))
+		{
+			rxQueueStats.overflows++;
+			return false;
+		}
+		rxFilterStats.accepted++;
+		depth = mrbusPktQueueDepth(q);
+		if (depth > rxQueueStats.highWater)
+			rxQueueStats.highWater = depth;
+		return true;
+	}
+	return __real_mrbusPktQueuePush(q, data, dataLen);
+}
+
+// How long one pass of the main loop may spend on received packets before
+//  getting back to inputs, logic, and outputs.  Whatever's left waits for the
+//  next pass.  At least one packet is always handled.
+#define RX_DRAIN_BUDGET_COUNTS  (2 * TIMESTAMP_COUNTS_PER_MS)
+
+void RxQueueDrain(CPState_t *cpState)
+{
+	uint32_t start = timestampGet();
+	uint8_t batch = 0;
+
+	while(mrbusPktQueueDepth(&mrbusRxQueue))
+	{
+		if (batch && (timestampGet() - start) >= RX_DRAIN_BUDGET_COUNTS)
+		{
+			if (rxQueueStats.budgetCutoffs < 0xFFFF)
+				rxQueueStats.budgetCutoffs++;
+			break;
+		}
+		PktHandler(cpState);
+		batch++;
+	}
+
+	if (batch > rxQueueStats.maxBatch)
+		rxQueueStats.maxBatch = batch;
+}
+
+#ifdef CP_PROFILE
+// CRC check timing for the 'D' 'C' diagnostic - Timer1 counts for
+//  PROFILE_CRC_RUNS checks of a dummy packet, first with the per-byte library
+//  loop PktHandler used to run and then with pktCrcValid().  Interrupts are
+//  held off so only the checks get timed.
+#define PROFILE_CRC_RUNS  16
+
+static bool crcCheckBytewise(const uint8_t* pkt)
 {
 	uint16_t crc = 0;
 	uint8_t i;
-	uint8_t rxBuffer[MRBUS_BUFFER_SIZE];
-	uint8_t txBuffer[MRBUS_BUFFER_SIZE];
 
-	if (0 == mrbusPktQueuePop(&mrbusRxQueue, rxBuffer, sizeof(rxBuffer)))
+	for(i=0; i<pkt[MRBUS_PKT_LEN]; i++)
+	{
+		if ((i != MRBUS_PKT_CRC_H) && (i != MRBUS_PKT_CRC_L))
+			crc = mrbusCRC16Update(crc, pkt[i]);
+	}
+	return ((UINT16_HIGH_BYTE(crc) == pkt[MRBUS_PKT_CRC_H]) && (UINT16_LOW_BYTE(crc) == pkt[MRBUS_PKT_CRC_L]));
+}
+
+static void crcCheckTiming(uint8_t len, uint16_t* bytewiseCounts, uint16_t* tableCounts)
+{
+	uint8_t pkt[MRBUS_BUFFER_SIZE];
+	volatile bool valid;
+	uint16_t start;
+	uint8_t i;
+
+	for (i=0; i<sizeof(pkt); i++)
+		pkt[i] = i;
+	pkt[MRBUS_PKT_LEN] = len;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		start = TCNT1;
+		for (i=0; i<PROFILE_CRC_RUNS; i++)
+			valid = crcCheckBytewise(pkt);
+		*bytewiseCounts = TCNT1 - start;
+
+		start = TCNT1;
+		for (i=0; i<PROFILE_CRC_RUNS; i++)
+			valid = pktCrcValid(pkt, sizeof(pkt));
+		*tableCounts = TCNT1 - start;
+	}
+	(void)valid;
+}
+#endif
+
+// Packets are handled where they sit in the receive queue, and replies are
+//  built straight into a transmit queue slot.  If the transmit queue's full
+//  the reply is dropped, the same as a failed push.
+void PktHandler(CPState_t *cpState)
+{
+	uint8_t i;
+	uint8_t* rxBuffer;
+	uint8_t* txBuffer;
+
+	if (NULL == (rxBuffer = pktQueueFront(&mrbusRxQueue)))
 		return;
 
 	//*************** PACKET FILTER ***************
@@ -1258,12 +1271,7 @@ void PktHandler(CPState_t *cpState)
 		goto PktIgnore;
 	
 	// CRC16 Test - is the packet intact?
-	for(i=0; i<rxBuffer[MRBUS_PKT_LEN]; i++)
-	{
-		if ((i != MRBUS_PKT_CRC_H) && (i != MRBUS_PKT_CRC_L)) 
-			crc = mrbusCRC16Update(crc, rxBuffer[i]);
-	}
-	if ((UINT16_HIGH_BYTE(crc) != rxBuffer[MRBUS_PKT_CRC_H]) || (UINT16_LOW_BYTE(crc) != rxBuffer[MRBUS_PKT_CRC_L]))
+	if (!pktCrcValid(rxBuffer, MRBUS_BUFFER_SIZE))
 		goto PktIgnore;
 		
 	//*************** END PACKET FILTER ***************
@@ -1276,15 +1284,18 @@ void PktHandler(CPState_t *cpState)
 	{
 		case 'A':
 			// PING packet
+			if (NULL == (txBuffer = pktQueueReserve(&mrbusTxQueue)))
+				goto PktIgnore;
 			txBuffer[MRBUS_PKT_DEST] = rxBuffer[MRBUS_PKT_SRC];
 			txBuffer[MRBUS_PKT_SRC] = mrbus_dev_addr;
 			txBuffer[MRBUS_PKT_LEN] = 6;
 			txBuffer[MRBUS_PKT_TYPE] = 'a';
-			mrbusPktQueuePush(&mrbusTxQueue, txBuffer, txBuffer[MRBUS_PKT_LEN]);
+			pktQueueCommit(&mrbusTxQueue);
 			goto PktIgnore;
 
 		case 'C':
 			// CTC Command
+			latencyStimulus(LATENCY_CTC);
 			// Structure of command:
 			//  byte 6:
 			//    'G' - Set/Clear route from entrance signal (byte 7 signal number, byte 8 'S'/'C' for set/clear)
@@ -1304,31 +1315,49 @@ void PktHandler(CPState_t *cpState)
 			if (rxBuffer[MRBUS_PKT_DEST] != mrbus_dev_addr)
 				goto PktIgnore;
 			
+			eeprom_write_byte((uint8_t*)(uint16_t)rxBuffer[6], rxBuffer[7]);
+			if (MRBUS_EE_DEVICE_ADDR == rxBuffer[6])
+			{
+				mrbus_dev_addr = eeprom_read_byte((uint8_t*)MRBUS_EE_DEVICE_ADDR);
+				// Status packet needs to go out under the new address
+				CPStateDirtySet(cpState, CP_DIRTY_ALL);
+			}
+			if (rxBuffer[6] >= EE_VINPUT_CONFIG_START && rxBuffer[6] <= EE_VINPUT_CONFIG_END)
+				CPVirtInputIndexRebuild(cpState);
+			if (EE_XIO_REFRESH_TIME == rxBuffer[6])
+				readXioRefreshTime();
+			if (rxBuffer[6] >= EE_XIO_DEBOUNCE_WIDTH && rxBuffer[6] <= EE_XIO_DEBOUNCE_WIDTH_END)
+				events |= EVENT_XIO_CONFIG;  // The XIOs belong to the main loop
+
+			// Reply comes from the new address if that's what was written
+			if (NULL == (txBuffer = pktQueueReserve(&mrbusTxQueue)))
+				goto PktIgnore;
 			txBuffer[MRBUS_PKT_DEST] = rxBuffer[MRBUS_PKT_SRC];
+			txBuffer[MRBUS_PKT_SRC] = mrbus_dev_addr;
 			txBuffer[MRBUS_PKT_LEN] = 8;
 			txBuffer[MRBUS_PKT_TYPE] = 'w';
-			eeprom_write_byte((uint8_t*)(uint16_t)rxBuffer[6], rxBuffer[7]);
 			txBuffer[6] = rxBuffer[6];
 			txBuffer[7] = rxBuffer[7];
-			if (MRBUS_EE_DEVICE_ADDR == rxBuffer[6])
-				mrbus_dev_addr = eeprom_read_byte((uint8_t*)MRBUS_EE_DEVICE_ADDR);
-			txBuffer[MRBUS_PKT_SRC] = mrbus_dev_addr;
-			mrbusPktQueuePush(&mrbusTxQueue, txBuffer, txBuffer[MRBUS_PKT_LEN]);
+			pktQueueCommit(&mrbusTxQueue);
 			goto PktIgnore;	
 
 		case 'R':
 			// EEPROM READ Packet
+			if (NULL == (txBuffer = pktQueueReserve(&mrbusTxQueue)))
+				goto PktIgnore;
 			txBuffer[MRBUS_PKT_DEST] = rxBuffer[MRBUS_PKT_SRC];
 			txBuffer[MRBUS_PKT_SRC] = mrbus_dev_addr;
 			txBuffer[MRBUS_PKT_LEN] = 8;
 			txBuffer[MRBUS_PKT_TYPE] = 'r';
 			txBuffer[6] = rxBuffer[6];
 			txBuffer[7] = eeprom_read_byte((uint8_t*)(uint16_t)rxBuffer[6]);
-			mrbusPktQueuePush(&mrbusTxQueue, txBuffer, txBuffer[MRBUS_PKT_LEN]);
+			pktQueueCommit(&mrbusTxQueue);
 			goto PktIgnore;
 
 		case 'V':
 			// Version
+			if (NULL == (txBuffer = pktQueueReserve(&mrbusTxQueue)))
+				goto PktIgnore;
 			txBuffer[MRBUS_PKT_DEST] = rxBuffer[MRBUS_PKT_SRC];
 			txBuffer[MRBUS_PKT_SRC] = mrbus_dev_addr;
 			txBuffer[MRBUS_PKT_LEN] = 16;
@@ -1343,7 +1372,163 @@ void PktHandler(CPState_t *cpState)
 			txBuffer[13] = 'O';
 			txBuffer[14] = '3';
 			txBuffer[15] = ' ';
-			mrbusPktQueuePush(&mrbusTxQueue, txBuffer, txBuffer[MRBUS_PKT_LEN]);
+			pktQueueCommit(&mrbusTxQueue);
+			goto PktIgnore;
+
+		case 'D':
+			// Diagnostics - must be directed at us and us only
+			//  byte 6:
+			//    'L' - Latency stats for class (byte 7): count, min, max, mean - 16 bit, 0.1ms units
+			//    'H' - Latency histogram for class (byte 7): six 16 bit bin counts
+			//    'P' - Profile counters for main loop stage (byte 7), CP_PROFILE builds only:
+			//            count (32 bit), total time (32 bit), worst case (16 bit) - Timer1 counts
+			//    'C' - CRC check timing for a packet length (byte 7), CP_PROFILE builds only:
+			//            Timer1 counts for 16 checks, per-byte loop then table (16 bit each).
+			//            Times TIMESTAMP_PRESCALER / 16 gives CPU cycles per packet.
+			//    'F' - Receive filter: packets queued, packets dropped, repeated status
+			//            packets skipped by the bit/byte rules - all 32 bit
+			//    'Q' - Receive queue: size, high water mark, most packets drained in one
+			//            pass (8 bit), packets lost to it being full (32 bit), drains
+			//            cut short by the time budget (16 bit)
+			//    'Z' - Zero all diagnostic counters
+			if (rxBuffer[MRBUS_PKT_DEST] != mrbus_dev_addr || rxBuffer[MRBUS_PKT_LEN] < 7)
+				goto PktIgnore;
+			if (NULL == (txBuffer = pktQueueReserve(&mrbusTxQueue)))
+				goto PktIgnore;
+
+			txBuffer[MRBUS_PKT_DEST] = rxBuffer[MRBUS_PKT_SRC];
+			txBuffer[MRBUS_PKT_SRC] = mrbus_dev_addr;
+			txBuffer[MRBUS_PKT_TYPE] = 'd';
+			txBuffer[6] = rxBuffer[6];
+
+			switch(rxBuffer[6])
+			{
+				case 'L':
+				case 'H':
+				{
+					const LatencyStats_t* stats = latencyStatsGet((rxBuffer[MRBUS_PKT_LEN] >= 8)?rxBuffer[7]:LATENCY_END);
+					if (NULL == stats)
+						goto PktIgnore;
+					txBuffer[7] = rxBuffer[7];
+
+					if ('L' == rxBuffer[6])
+					{
+						uint16_t mean = latencyMean(stats);
+						uint16_t min = stats->count?stats->min:0;
+						txBuffer[MRBUS_PKT_LEN] = 16;
+						txBuffer[8] = UINT16_HIGH_BYTE(stats->count);
+						txBuffer[9] = UINT16_LOW_BYTE(stats->count);
+						txBuffer[10] = UINT16_HIGH_BYTE(min);
+						txBuffer[11] = UINT16_LOW_BYTE(min);
+						txBuffer[12] = UINT16_HIGH_BYTE(stats->max);
+						txBuffer[13] = UINT16_LOW_BYTE(stats->max);
+						txBuffer[14] = UINT16_HIGH_BYTE(mean);
+						txBuffer[15] = UINT16_LOW_BYTE(mean);
+					} else {
+						txBuffer[MRBUS_PKT_LEN] = 8 + 2 * LATENCY_HISTOGRAM_BINS;
+						for(i=0; i<LATENCY_HISTOGRAM_BINS; i++)
+						{
+							txBuffer[8 + 2*i] = UINT16_HIGH_BYTE(stats->histogram[i]);
+							txBuffer[9 + 2*i] = UINT16_LOW_BYTE(stats->histogram[i]);
+						}
+					}
+					break;
+				}
+
+#ifdef CP_PROFILE
+				case 'P':
+				{
+					const ProfileStats_t* stats = profileStatsGet((rxBuffer[MRBUS_PKT_LEN] >= 8)?rxBuffer[7]:PROFILE_END);
+					if (NULL == stats)
+						goto PktIgnore;
+					txBuffer[MRBUS_PKT_LEN] = 18;
+					txBuffer[7] = rxBuffer[7];
+					for(i=0; i<4; i++)
+					{
+						txBuffer[8 + i] = (stats->count >> (24 - 8*i)) & 0xFF;
+						txBuffer[12 + i] = (stats->sum >> (24 - 8*i)) & 0xFF;
+					}
+					txBuffer[16] = UINT16_HIGH_BYTE(stats->worst);
+					txBuffer[17] = UINT16_LOW_BYTE(stats->worst);
+					break;
+				}
+
+				case 'C':
+				{
+					uint16_t bytewiseCounts, tableCounts;
+					if (rxBuffer[MRBUS_PKT_LEN] < 8 || rxBuffer[7] < MRBUS_PKT_TYPE || rxBuffer[7] > MRBUS_BUFFER_SIZE)
+						goto PktIgnore;
+					crcCheckTiming(rxBuffer[7], &bytewiseCounts, &tableCounts);
+					txBuffer[MRBUS_PKT_LEN] = 12;
+					txBuffer[7] = rxBuffer[7];
+					txBuffer[8] = UINT16_HIGH_BYTE(bytewiseCounts);
+					txBuffer[9] = UINT16_LOW_BYTE(bytewiseCounts);
+					txBuffer[10] = UINT16_HIGH_BYTE(tableCounts);
+					txBuffer[11] = UINT16_LOW_BYTE(tableCounts);
+					break;
+				}
+#endif
+
+				case 'F':
+				{
+					RxFilterStats_t stats;
+					ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+					{
+						stats.accepted = rxFilterStats.accepted;
+						stats.dropped = rxFilterStats.dropped;
+					}
+					uint32_t repeats = CPMRBusVirtInputRepeatsSkipped();
+					txBuffer[MRBUS_PKT_LEN] = 19;
+					for(i=0; i<4; i++)
+					{
+						txBuffer[7 + i] = (stats.accepted >> (24 - 8*i)) & 0xFF;
+						txBuffer[11 + i] = (stats.dropped >> (24 - 8*i)) & 0xFF;
+						txBuffer[15 + i] = (repeats >> (24 - 8*i)) & 0xFF;
+					}
+					break;
+				}
+
+				case 'Q':
+				{
+					RxQueueStats_t stats;
+					ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+					{
+						stats.overflows = rxQueueStats.overflows;
+						stats.budgetCutoffs = rxQueueStats.budgetCutoffs;
+						stats.highWater = rxQueueStats.highWater;
+						stats.maxBatch = rxQueueStats.maxBatch;
+					}
+					txBuffer[MRBUS_PKT_LEN] = 16;
+					txBuffer[7] = rxBuffer_DEPTH;
+					txBuffer[8] = stats.highWater;
+					txBuffer[9] = stats.maxBatch;
+					for(i=0; i<4; i++)
+						txBuffer[10 + i] = (stats.overflows >> (24 - 8*i)) & 0xFF;
+					txBuffer[14] = UINT16_HIGH_BYTE(stats.budgetCutoffs);
+					txBuffer[15] = UINT16_LOW_BYTE(stats.budgetCutoffs);
+					break;
+				}
+
+				case 'Z':
+					latencyReset();
+					PROFILE_RESET();
+					ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+					{
+						rxFilterStats.accepted = 0;
+						rxFilterStats.dropped = 0;
+						rxQueueStats.overflows = 0;
+						rxQueueStats.budgetCutoffs = 0;
+						rxQueueStats.highWater = 0;
+						rxQueueStats.maxBatch = 0;
+					}
+					CPMRBusVirtInputRepeatsReset();
+					txBuffer[MRBUS_PKT_LEN] = 7;
+					break;
+
+				default:
+					goto PktIgnore;
+			}
+			pktQueueCommit(&mrbusTxQueue);
 			goto PktIgnore;
 
 		case 'X':
@@ -1371,8 +1556,8 @@ PktIgnore:
 	// way to jump to a common block of cleanup code at the end of a function 
 
 	// This section resets anything that needs to be reset in order to allow us to receive
-	// another packet.  Typically, that's just clearing the MRBUS_RX_PKT_READY flag to 
-	// indicate to the core library that the rxBuffer is clear.
+	// another packet.  Here that's handing the packet's slot back to the receive queue.
+	mrbusPktQueueDrop(&mrbusRxQueue);
 	return;	
 }
 
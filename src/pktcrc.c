@@ -0,0 +1,116 @@
+/*************************************************************************
+Title:    Table-Driven MRBus Packet CRC
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     pktcrc.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdlib.h>
+#include <avr/pgmspace.h>
+
+#include "mrbus.h"
+#include "pktcrc.h"
+
+// The MRBus CRC16 is a straight left-shifting CRC, so a byte update is
+//  crc = (crc << 8) ^ table[(crc >> 8) ^ a].  The table is split into high
+//  and low bytes so each half is a single pgm_read_byte.
+//
+// Flash budget: the two halves are 512 bytes, against roughly 620 for all
+//  the other PROGMEM tables together (route table 238, the pin, gather and
+//  debounce tables, the aspect tables).  That's about 3.5% of the
+//  ATmega328P's 32K between them - "make size" has the whole image.
+static const uint8_t pktCrcTableHigh[256] PROGMEM =
+{
+	0x00, 0xA0, 0xE0, 0x40, 0x60, 0xC0, 0x80, 0x20, 0xC0, 0x60, 0x20, 0x80, 0xA0, 0x00, 0x40, 0xE0,
+	0x20, 0x80, 0xC0, 0x60, 0x40, 0xE0, 0xA0, 0x00, 0xE0, 0x40, 0x00, 0xA0, 0x80, 0x20, 0x60, 0xC0,
+	0x40, 0xE0, 0xA0, 0x00, 0x20, 0x80, 0xC0, 0x60, 0x80, 0x20, 0x60, 0xC0, 0xE0, 0x40, 0x00, 0xA0,
+	0x60, 0xC0, 0x80, 0x20, 0x00, 0xA0, 0xE0, 0x40, 0xA0, 0x00, 0x40, 0xE0, 0xC0, 0x60, 0x20, 0x80,
+	0x80, 0x20, 0x60, 0xC0, 0xE0, 0x40, 0x00, 0xA0, 0x40, 0xE0, 0xA0, 0x00, 0x20, 0x80, 0xC0, 0x60,
+	0xA0, 0x00, 0x40, 0xE0, 0xC0, 0x60, 0x20, 0x80, 0x60, 0xC0, 0x80, 0x20, 0x00, 0xA0, 0xE0, 0x40,
+	0xC0, 0x60, 0x20, 0x80, 0xA0, 0x00, 0x40, 0xE0, 0x00, 0xA0, 0xE0, 0x40, 0x60, 0xC0, 0x80, 0x20,
+	0xE0, 0x40, 0x00, 0xA0, 0x80, 0x20, 0x60, 0xC0, 0x20, 0x80, 0xC0, 0x60, 0x40, 0xE0, 0xA0, 0x00,
+	0xA0, 0x00, 0x40, 0xE0, 0xC0, 0x60, 0x20, 0x80, 0x60, 0xC0, 0x80, 0x20, 0x00, 0xA0, 0xE0, 0x40,
+	0x80, 0x20, 0x60, 0xC0, 0xE0, 0x40, 0x00, 0xA0, 0x40, 0xE0, 0xA0, 0x00, 0x20, 0x80, 0xC0, 0x60,
+	0xE0, 0x40, 0x00, 0xA0, 0x80, 0x20, 0x60, 0xC0, 0x20, 0x80, 0xC0, 0x60, 0x40, 0xE0, 0xA0, 0x00,
+	0xC0, 0x60, 0x20, 0x80, 0xA0, 0x00, 0x40, 0xE0, 0x00, 0xA0, 0xE0, 0x40, 0x60, 0xC0, 0x80, 0x20,
+	0x20, 0x80, 0xC0, 0x60, 0x40, 0xE0, 0xA0, 0x00, 0xE0, 0x40, 0x00, 0xA0, 0x80, 0x20, 0x60, 0xC0,
+	0x00, 0xA0, 0xE0, 0x40, 0x60, 0xC0, 0x80, 0x20, 0xC0, 0x60, 0x20, 0x80, 0xA0, 0x00, 0x40, 0xE0,
+	0x60, 0xC0, 0x80, 0x20, 0x00, 0xA0, 0xE0, 0x40, 0xA0, 0x00, 0x40, 0xE0, 0xC0, 0x60, 0x20, 0x80,
+	0x40, 0xE0, 0xA0, 0x00, 0x20, 0x80, 0xC0, 0x60, 0x80, 0x20, 0x60, 0xC0, 0xE0, 0x40, 0x00, 0xA0,
+};
+
+static const uint8_t pktCrcTableLow[256] PROGMEM =
+{
+	0x00, 0x01, 0x03, 0x02, 0x07, 0x06, 0x04, 0x05, 0x0E, 0x0F, 0x0D, 0x0C, 0x09, 0x08, 0x0A, 0x0B,
+	0x1D, 0x1C, 0x1E, 0x1F, 0x1A, 0x1B, 0x19, 0x18, 0x13, 0x12, 0x10, 0x11, 0x14, 0x15, 0x17, 0x16,
+	0x3A, 0x3B, 0x39, 0x38, 0x3D, 0x3C, 0x3E, 0x3F, 0x34, 0x35, 0x37, 0x36, 0x33, 0x32, 0x30, 0x31,
+	0x27, 0x26, 0x24, 0x25, 0x20, 0x21, 0x23, 0x22, 0x29, 0x28, 0x2A, 0x2B, 0x2E, 0x2F, 0x2D, 0x2C,
+	0x74, 0x75, 0x77, 0x76, 0x73, 0x72, 0x70, 0x71, 0x7A, 0x7B, 0x79, 0x78, 0x7D, 0x7C, 0x7E, 0x7F,
+	0x69, 0x68, 0x6A, 0x6B, 0x6E, 0x6F, 0x6D, 0x6C, 0x67, 0x66, 0x64, 0x65, 0x60, 0x61, 0x63, 0x62,
+	0x4E, 0x4F, 0x4D, 0x4C, 0x49, 0x48, 0x4A, 0x4B, 0x40, 0x41, 0x43, 0x42, 0x47, 0x46, 0x44, 0x45,
+	0x53, 0x52, 0x50, 0x51, 0x54, 0x55, 0x57, 0x56, 0x5D, 0x5C, 0x5E, 0x5F, 0x5A, 0x5B, 0x59, 0x58,
+	0xE9, 0xE8, 0xEA, 0xEB, 0xEE, 0xEF, 0xED, 0xEC, 0xE7, 0xE6, 0xE4, 0xE5, 0xE0, 0xE1, 0xE3, 0xE2,
+	0xF4, 0xF5, 0xF7, 0xF6, 0xF3, 0xF2, 0xF0, 0xF1, 0xFA, 0xFB, 0xF9, 0xF8, 0xFD, 0xFC, 0xFE, 0xFF,
+	0xD3, 0xD2, 0xD0, 0xD1, 0xD4, 0xD5, 0xD7, 0xD6, 0xDD, 0xDC, 0xDE, 0xDF, 0xDA, 0xDB, 0xD9, 0xD8,
+	0xCE, 0xCF, 0xCD, 0xCC, 0xC9, 0xC8, 0xCA, 0xCB, 0xC0, 0xC1, 0xC3, 0xC2, 0xC7, 0xC6, 0xC4, 0xC5,
+	0x9D, 0x9C, 0x9E, 0x9F, 0x9A, 0x9B, 0x99, 0x98, 0x93, 0x92, 0x90, 0x91, 0x94, 0x95, 0x97, 0x96,
+	0x80, 0x81, 0x83, 0x82, 0x87, 0x86, 0x84, 0x85, 0x8E, 0x8F, 0x8D, 0x8C, 0x89, 0x88, 0x8A, 0x8B,
+	0xA7, 0xA6, 0xA4, 0xA5, 0xA0, 0xA1, 0xA3, 0xA2, 0xA9, 0xA8, 0xAA, 0xAB, 0xAE, 0xAF, 0xAD, 0xAC,
+	0xBA, 0xBB, 0xB9, 0xB8, 0xBD, 0xBC, 0xBE, 0xBF, 0xB4, 0xB5, 0xB7, 0xB6, 0xB3, 0xB2, 0xB0, 0xB1,
+};
+
+uint16_t pktCrcUpdate(uint16_t crc, uint8_t a)
+{
+	uint8_t idx = (uint8_t)(crc >> 8) ^ a;
+	return (((uint16_t)((uint8_t)crc ^ pgm_read_byte(&pktCrcTableHigh[idx])) << 8) | pgm_read_byte(&pktCrcTableLow[idx]));
+}
+
+static inline uint16_t pktCrcRun(uint16_t crc, const uint8_t* data, uint8_t len)
+{
+	uint8_t crcHigh = crc >> 8;
+	uint8_t crcLow = crc & 0xFF;
+
+	while(len--)
+	{
+		uint8_t idx = crcHigh ^ *data++;
+		crcHigh = crcLow ^ pgm_read_byte(&pktCrcTableHigh[idx]);
+		crcLow = pgm_read_byte(&pktCrcTableLow[idx]);
+	}
+	return (((uint16_t)crcHigh << 8) | crcLow);
+}
+
+// The CRC bytes sit together ahead of the type byte, so the packet is just
+//  two runs - the header in front of them and everything after
+typedef char PktCrcFieldsAdjacent_t[(MRBUS_PKT_CRC_H == MRBUS_PKT_CRC_L + 1 && MRBUS_PKT_TYPE == MRBUS_PKT_CRC_H + 1) ? 1 : -1];
+
+uint16_t pktCrcCompute(const uint8_t* pkt, uint8_t len)
+{
+	uint16_t crc = pktCrcRun(0, pkt, MRBUS_PKT_CRC_L);
+	return pktCrcRun(crc, pkt + MRBUS_PKT_TYPE, len - MRBUS_PKT_TYPE);
+}
+
+bool pktCrcValid(const uint8_t* pkt, uint8_t bufferLen)
+{
+	uint8_t len = min(pkt[MRBUS_PKT_LEN], bufferLen);
+	uint16_t crc;
+
+	if (len < MRBUS_PKT_TYPE)
+		return false;
+
+	crc = pktCrcCompute(pkt, len);
+	return ((crc >> 8) == pkt[MRBUS_PKT_CRC_H] && (crc & 0xFF) == pkt[MRBUS_PKT_CRC_L]);
+}
@@ -0,0 +1,49 @@
+/*************************************************************************
+Title:    Table-Driven MRBus Packet CRC Header
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     pktcrc.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _PKTCRC_H_
+#define _PKTCRC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Byte-at-a-time version of the MRBus CRC16 - same polynomial and results as
+//  mrbusCRC16Update(), but two flash reads per byte (the high and low halves
+//  of one table entry) instead of two nibble passes with their shifting and
+//  masking.  "mrb-xo3-host verify" checks it against the library.
+//
+// Whether that's any quicker on the AVR hasn't been measured yet - the host
+//  bench only says something about the host.  A CP_PROFILE build answers
+//  'D' 'C' with Timer1 counts for both, which is where the numbers should
+//  come from before anyone leans on this for speed.
+
+uint16_t pktCrcUpdate(uint16_t crc, uint8_t a);
+
+// CRC of a whole packet of len bytes, leaving out the two CRC bytes.
+//  len must cover at least the header (MRBUS_PKT_TYPE bytes).
+uint16_t pktCrcCompute(const uint8_t* pkt, uint8_t len);
+
+// True if the packet's CRC bytes match its contents.  The length comes from
+//  MRBUS_PKT_LEN and is clamped to bufferLen; anything shorter than the
+//  header fails.
+bool pktCrcValid(const uint8_t* pkt, uint8_t bufferLen);
+
+#endif
@@ -0,0 +1,78 @@
+/*************************************************************************
+Title:    In-Place MRBus Packet Queue Access Header
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     pktqueue.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _PKTQUEUE_H_
+#define _PKTQUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <util/atomic.h>
+#include "mrbus.h"
+
+// Lets packets be read and built right in the MRBus queue slots rather than
+//  copied through buffers on the stack by mrbusPktQueuePop()/Push().
+//
+// The MRBus library has no in-place calls, so these work on MRBusPktQueue
+//  directly and follow its push/drop index handling.  The checks below stop
+//  the build if the library's queue stops looking like what they expect.
+typedef char PktQueueSlotSize_t[(sizeof(((MRBusPacket*)0)->pkt) == MRBUS_BUFFER_SIZE) ? 1 : -1];
+typedef char PktQueueSlots_t[__builtin_types_compatible_p(__typeof__(((MRBusPktQueue*)0)->pktBufferArray), MRBusPacket*) ? 1 : -1];
+typedef char PktQueueIndexes_t[(__builtin_types_compatible_p(__typeof__(((MRBusPktQueue*)0)->headIdx), volatile uint8_t)
+	&& __builtin_types_compatible_p(__typeof__(((MRBusPktQueue*)0)->tailIdx), volatile uint8_t)
+	&& __builtin_types_compatible_p(__typeof__(((MRBusPktQueue*)0)->pktBufferArraySz), uint8_t)) ? 1 : -1];
+typedef char PktQueueFull_t[__builtin_types_compatible_p(__typeof__(((MRBusPktQueue*)0)->full), volatile bool) ? 1 : -1];
+
+// Oldest packet in the queue, in its slot, or NULL if the queue's empty.
+//  The receive interrupt can't wrap around onto it, so it stays valid until
+//  mrbusPktQueueDrop() hands the slot back.
+static inline uint8_t* pktQueueFront(MRBusPktQueue* q)
+{
+	if (mrbusPktQueueEmpty(q))
+		return NULL;
+	return q->pktBufferArray[q->tailIdx].pkt;
+}
+
+// Next free slot to build a packet in, or NULL if the queue's full.  Nothing
+//  is queued until pktQueueCommit(), so a reserved slot can just be abandoned.
+//  It still holds whatever was there last - fill in everything up to the
+//  length byte except the CRC, which goes on at transmit.
+//  Main loop only - nothing else may push onto the queue in between.
+static inline uint8_t* pktQueueReserve(MRBusPktQueue* q)
+{
+	if (mrbusPktQueueFull(q))
+		return NULL;
+	return q->pktBufferArray[q->headIdx].pkt;
+}
+
+// Queues the packet built in the slot from pktQueueReserve()
+static inline void pktQueueCommit(MRBusPktQueue* q)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (++q->headIdx >= q->pktBufferArraySz)
+			q->headIdx = 0;
+		if (q->headIdx == q->tailIdx)
+			q->full = true;
+	}
+}
+
+#endif
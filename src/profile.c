@@ -0,0 +1,64 @@
+/*************************************************************************
+Title:    Main Loop Stage Profiler
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     profile.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifdef CP_PROFILE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "timestamp.h"
+#include "profile.h"
+
+static uint32_t profileStartTime[PROFILE_END];
+static ProfileStats_t profileStats[PROFILE_END];
+
+void profileReset(void)
+{
+	memset(profileStats, 0, sizeof(profileStats));
+}
+
+void profileStart(ProfileStage_t stage)
+{
+	profileStartTime[stage] = timestampGet();
+}
+
+void profileStop(ProfileStage_t stage)
+{
+	uint32_t elapsed = timestampGet() - profileStartTime[stage];
+	ProfileStats_t* stats = &profileStats[stage];
+
+	if (0xFFFFFFFF == stats->count)
+		return;
+
+	stats->count++;
+	stats->sum = (stats->sum > 0xFFFFFFFF - elapsed) ? 0xFFFFFFFF : stats->sum + elapsed;
+	if (elapsed > stats->worst)
+		stats->worst = (elapsed > 0xFFFF) ? 0xFFFF : elapsed;
+}
+
+const ProfileStats_t* profileStatsGet(uint8_t stage)
+{
+	if (stage >= PROFILE_END)
+		return NULL;
+	return &profileStats[stage];
+}
+
+#endif
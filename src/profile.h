@@ -0,0 +1,71 @@
+/*************************************************************************
+Title:    Main Loop Stage Profiler Header
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     profile.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <stdint.h>
+
+// Build with -DCP_PROFILE to time each stage of the main loop against the
+//  Timer1 timestamp.  Without it, the PROFILE_ macros compile away to nothing.
+//  Times are in Timer1 counts - TIMESTAMP_PRESCALER CPU cycles apiece.
+
+typedef enum
+{
+	PROFILE_PKT_HANDLER = 0,
+	PROFILE_XIO_PROCESS,
+	PROFILE_INPUT_FILTER,
+	PROFILE_TURNOUTS,
+	PROFILE_VITAL_LOGIC,
+	PROFILE_OUTPUTS,
+	PROFILE_STATUS_PACKET,
+	PROFILE_TRANSMIT,
+	PROFILE_LOOP,        // The whole awake part of a pass, stages and all
+	PROFILE_END
+} ProfileStage_t;
+
+typedef struct
+{
+	uint32_t count;
+	uint32_t sum;    // Pins at 0xFFFFFFFF rather than wrapping
+	uint16_t worst;  // Pins at 0xFFFF
+} ProfileStats_t;
+
+#ifdef CP_PROFILE
+
+void profileReset(void);
+void profileStart(ProfileStage_t stage);
+void profileStop(ProfileStage_t stage);
+const ProfileStats_t* profileStatsGet(uint8_t stage);
+
+#define PROFILE_START(stage)  profileStart(stage)
+#define PROFILE_STOP(stage)   profileStop(stage)
+#define PROFILE_RESET()       profileReset()
+
+#else
+
+#define PROFILE_START(stage)
+#define PROFILE_STOP(stage)
+#define PROFILE_RESET()
+
+#endif
+
+#endif
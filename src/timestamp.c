@@ -0,0 +1,58 @@
+/*************************************************************************
+Title:    Timer1 Timestamp
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     timestamp.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdlib.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#include "timestamp.h"
+
+static volatile uint16_t timestampHigh = 0;
+
+void timestampInit(void)
+{
+	TCCR1A = 0;
+	TCCR1B = _BV(CS11);  // clk/8, normal mode
+	TCNT1 = 0;
+	TIFR1 = _BV(TOV1);
+	TIMSK1 |= _BV(TOIE1);
+}
+
+ISR(TIMER1_OVF_vect)
+{
+	timestampHigh++;
+}
+
+uint32_t timestampGet(void)
+{
+	uint16_t low, high;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		low = TCNT1;
+		high = timestampHigh;
+		// Overflowed but the interrupt hasn't had a chance to run yet
+		if ((TIFR1 & _BV(TOV1)) && low < 0x8000)
+			high++;
+	}
+	return ((uint32_t)high << 16) | low;
+}
@@ -0,0 +1,35 @@
+/*************************************************************************
+Title:    Timer1 Timestamp Header
+Authors:  Nathan D. Holmes <maverick@drgw.net>
+File:     timestamp.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2021 Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _TIMESTAMP_H_
+#define _TIMESTAMP_H_
+
+#include <stdint.h>
+
+// Timer1 free-runs at clk/8 (0.4us per count at 20MHz), with the overflow
+//  interrupt extending it out to 32 bits - a bit under half an hour to wrap
+#define TIMESTAMP_PRESCALER        8
+#define TIMESTAMP_COUNTS_PER_MS    (F_CPU / TIMESTAMP_PRESCALER / 1000UL)
+
+void timestampInit(void);
+uint32_t timestampGet(void);
+
+#endif
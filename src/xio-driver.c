@@ -22,9 +22,11 @@ LICENSE:
 /* 0x00-0x04 - input registers */
 /* 0x08-0x0C - output registers */
 /* 0x18-0x1C - direction registers - 0 is output, 1 is input */
+/* 0x20-0x24 - interrupt mask registers - 0 lets the pin assert INT */
 #include <stdlib.h>
 #include <string.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include <util/delay.h>
 
 #include "avr-i2c-master.h"
@@ -39,38 +41,430 @@ LICENSE:
 #define PIN(port)  PIN_(port)
 
 
-void initDebounceState(XIODebounceState* d, uint8_t initialState)
+// Vertical counter debounce - clock[] holds one bit of every pin's counter
+//  per word.  Any pin that differs from its debounced state counts up, any pin
+//  that matches gets its counter cleared, and a pin whose counter carries out
+//  of its top bit has held the new state long enough to be accepted.  Which
+//  counter bits a pin uses depends on which way it's headed - the assert
+//  widths for a pin that's low now, the release widths for one that's high.
+//  Those enables are worked out fresh each time from the port widths and the
+//  per-pin table in flash, so they take no RAM.
+//  Generated once for the 32 bit A-D word and once for the port E byte.
+#define XIO_DEBOUNCE_FUNCTION(name, type) \
+static type name(type raw, type* state, type* clock, const type* assertEnable, const type* releaseEnable) \
+{ \
+	type delta = raw ^ *state; \
+	type enable = (assertEnable[0] & ~*state) | (releaseEnable[0] & *state); \
+	type carry = delta & enable; \
+	type changes = delta & ~enable; \
+	uint8_t k; \
+	for(k=0; k<XIO_DEBOUNCE_MAX_WIDTH; k++) \
+	{ \
+		type next = (k < XIO_DEBOUNCE_MAX_WIDTH-1) ? ((assertEnable[k+1] & ~*state) | (releaseEnable[k+1] & *state)) : 0; \
+		type carryOut = clock[k] & carry; \
+		clock[k] = (clock[k] ^ carry) & delta; \
+		changes |= carryOut & ~next; \
+		carry = carryOut & next; \
+	} \
+	*state ^= changes; \
+	return changes; \
+}
+
+XIO_DEBOUNCE_FUNCTION(debounceWord, uint32_t)
+XIO_DEBOUNCE_FUNCTION(debounceByte, uint8_t)
+
+static void debounce(XIODebounceState* d, const uint8_t* raw)
 {
-	d->clock_A = d->clock_B = 0;
-	d->debounced_state = initialState;
+	uint32_t rawWord = (uint32_t)raw[0] | ((uint32_t)raw[1] << 8) | ((uint32_t)raw[2] << 16) | ((uint32_t)raw[3] << 24);
+	uint32_t assertEnable[XIO_DEBOUNCE_MAX_WIDTH], releaseEnable[XIO_DEBOUNCE_MAX_WIDTH];
+	uint8_t assertEnableE[XIO_DEBOUNCE_MAX_WIDTH], releaseEnableE[XIO_DEBOUNCE_MAX_WIDTH];
+	XIODebouncePinWidths pin;
+	uint8_t k, port;
+
+	if (NULL != d->pinWidths)
+		memcpy_P(&pin, d->pinWidths, sizeof(pin));
+	else
+		memset(&pin, 0, sizeof(pin));
+
+	for(k=0; k<XIO_DEBOUNCE_MAX_WIDTH; k++)
+	{
+		uint32_t portEnable = 0;
+		uint8_t portEnableE = (d->portWidth[XIO_PORT_E] > k) ? 0xFF : 0;
+		for(port=XIO_PORT_A; port<XIO_PORT_E; port++)
+		{
+			if (d->portWidth[port] > k)
+				portEnable |= (uint32_t)0xFF << (8 * port);
+		}
+		assertEnable[k] = (portEnable & ~pin.assertPins) | pin.assertEnable[k];
+		releaseEnable[k] = (portEnable & ~pin.releasePins) | pin.releaseEnable[k];
+		assertEnableE[k] = (portEnableE & ~pin.assertPinsE) | pin.assertEnableE[k];
+		releaseEnableE[k] = (portEnableE & ~pin.releasePinsE) | pin.releaseEnableE[k];
+	}
+
+	d->changed |= debounceWord(rawWord, &d->state, d->clock, assertEnable, releaseEnable);
+	d->changedE |= debounceByte(raw[4], &d->stateE, d->clockE, assertEnableE, releaseEnableE);
 }
 
-uint8_t debounce(XIODebounceState* d, uint8_t raw_inputs)
+static void debounceClockClear(XIODebounceState* d, uint8_t port, uint8_t bitMask)
 {
-	uint8_t delta = raw_inputs ^ d->debounced_state;   //Find all of the changes
-	uint8_t changes;
+	uint8_t k;
+	for(k=0; k<XIO_DEBOUNCE_MAX_WIDTH; k++)
+	{
+		if (XIO_PORT_E == port)
+			d->clockE[k] &= ~bitMask;
+		else
+			d->clock[k] &= ~((uint32_t)bitMask << (8 * port));
+	}
+}
+
+void xioSetDebounceWidth(XIOControl* xio, uint8_t port, uint8_t width)
+{
+	XIODebounceState* d = &xio->debounce;
+
+	if (port > XIO_PORT_E)
+		return;
+	if (width > XIO_DEBOUNCE_MAX_WIDTH)
+		width = XIO_DEBOUNCE_DEFAULT_WIDTH;
 
-	d->clock_A ^= d->clock_B;                     //Increment the counters
-	d->clock_B  = ~d->clock_B;
+	d->portWidth[port] = width;
+	debounceClockClear(d, port, 0xFF);
+}
 
-	d->clock_A &= delta;                       //Reset the counters if no changes
-	d->clock_B &= delta;                       //were detected.
+// Hand the XIO its per-pin widths - pinWidths points into flash and has to
+//  stay put.  Every other pin follows its port's width both ways.
+void xioSetDebouncePinWidths(XIOControl* xio, const XIODebouncePinWidths* pinWidths)
+{
+	XIODebounceState* d = &xio->debounce;
 
-	changes = ~((~delta) | d->clock_A | d->clock_B);
-	d->debounced_state ^= changes;
-	return(changes & ~(d->debounced_state));
+	d->pinWidths = pinWidths;
+	memset(d->clock, 0, sizeof(d->clock));
+	memset(d->clockE, 0, sizeof(d->clockE));
 }
 
 
-void xioDirectionSend(XIOControl* xio)
+// Asynchronous transaction engine
+//  Reads and writes are queued up and then walked through the bus one phase
+//  at a time by xioProcess(), which never waits on the bus.  The avr-i2c
+//  library owns the TWI interrupt, so the engine is pumped from the main loop
+//  instead - each call checks i2c_busy() once and, if the bus is free,
+//  finishes the current phase and starts the next one.
+
+// A transaction already waiting for the same XIO and operation isn't queued
+//  again, so with a slot for each of the four operations on every XIO the
+//  queue can't fill.  Callers still check, in case it ever does.
+#define XIO_QUEUE_OPS            4
+#define XIO_QUEUE_DEPTH          (XIO_QUEUE_OPS * XIO_MAX_DEVICES)
+
+#define XIO_OP_READ_INPUTS       0
+#define XIO_OP_WRITE_OUTPUTS     1
+#define XIO_OP_WRITE_DIRECTION   2
+#define XIO_OP_WRITE_IRQ_MASK    3
+
+#define XIO_PHASE_IDLE           0
+#define XIO_PHASE_WRITE          1
+#define XIO_PHASE_READ_POINTER   2
+#define XIO_PHASE_READ_DATA      3
+
+typedef struct
+{
+	XIOControl* xio;
+	uint8_t op;
+} XIOTransaction;
+
+static XIOTransaction xioQueue[XIO_QUEUE_DEPTH];
+static uint8_t xioQueueHead = 0;
+static uint8_t xioQueueCount = 0;
+static XIOTransaction xioCurrent;
+static uint8_t xioPhase = XIO_PHASE_IDLE;
+
+typedef char XIOQueueOpsFit_t[(XIO_OP_WRITE_IRQ_MASK < XIO_QUEUE_OPS) ? 1 : -1];
+
+static bool xioTransactionQueued(XIOControl* xio, uint8_t op)
+{
+	uint8_t i;
+	for(i=0; i<xioQueueCount; i++)
+	{
+		XIOTransaction* t = &xioQueue[(xioQueueHead + i) % XIO_QUEUE_DEPTH];
+		if (t->xio == xio && t->op == op)
+			return true;
+	}
+	return false;
+}
+
+static bool xioQueueTransaction(XIOControl* xio, uint8_t op)
+{
+	// If the same operation is already waiting, let it stand - data is only
+	//  picked up from the XIOControl when the transaction goes out on the bus
+	if (xioTransactionQueued(xio, op))
+		return true;
+
+	if (xioQueueCount >= XIO_QUEUE_DEPTH)
+		return false;
+
+	xioQueue[(xioQueueHead + xioQueueCount) % XIO_QUEUE_DEPTH].xio = xio;
+	xioQueue[(xioQueueHead + xioQueueCount) % XIO_QUEUE_DEPTH].op = op;
+	xioQueueCount++;
+	return true;
+}
+
+// Sends the registers in regs[] that differ from the committed copy as one
+//  auto-increment burst, starting at the first changed register and ending at
+//  the last.  If the committed copy isn't valid, all five go out.
+//  Returns false if there was nothing to send.
+static bool xioRegisterWrite(XIOControl* xio, uint8_t regBase, const uint8_t* regs, uint8_t* committed, uint8_t committedFlag)
 {
-	uint8_t i2cBuf[8], i;
+	uint8_t i2cBuf[8];
+	uint8_t first = 0, last = 4, i;
+
+	if (xio->status & committedFlag)
+	{
+		while(first < 5 && regs[first] == committed[first])
+			first++;
+		if (first >= 5)
+			return false;
+		while(regs[last] == committed[last])
+			last--;
+	}
+
 	i2cBuf[0] = xio->address;
-	i2cBuf[1] = 0x80 | 0x18;  // 0x80 is auto-increment
+	i2cBuf[1] = 0x80 | (regBase + first);  // 0x80 is auto-increment
+	for(i=first; i<=last; i++)
+	{
+		i2cBuf[2+i-first] = regs[i];
+		committed[i] = regs[i];
+	}
+	xio->status |= committedFlag;
+	i2c_transmit(i2cBuf, 3 + last - first, 1);
+	return true;
+}
+
+static bool xioStartTransaction(void)
+{
+	uint8_t i2cBuf[8];
+	uint8_t i;
+	XIOControl* xio = xioCurrent.xio;
+
+	switch(xioCurrent.op)
+	{
+		case XIO_OP_READ_INPUTS:
+			i2cBuf[0] = xio->address;
+			i2cBuf[1] = 0x80;  // 0x80 is auto-increment, 0x00 is base of the input registers
+			i2c_transmit(i2cBuf, 2, 0);
+			xioPhase = XIO_PHASE_READ_POINTER;
+			return true;
+
+		case XIO_OP_WRITE_DIRECTION:
+			if (!xioRegisterWrite(xio, 0x18, xio->direction, xio->committedDirection, XIO_DIRECTION_COMMITTED))
+				return false;
+			xioPhase = XIO_PHASE_WRITE;
+			return true;
+
+		case XIO_OP_WRITE_IRQ_MASK:
+			// Only inputs get to assert the interrupt line
+			for(i=0; i<5; i++)
+				i2cBuf[i] = ~xio->direction[i];
+			if (!xioRegisterWrite(xio, 0x20, i2cBuf, xio->committedIrqMask, XIO_IRQ_MASK_COMMITTED))
+				return false;
+			xioPhase = XIO_PHASE_WRITE;
+			return true;
+
+		case XIO_OP_WRITE_OUTPUTS:
+			for(i=0; i<5; i++)
+				i2cBuf[i] = xio->io[i] & ~xio->direction[i];
+			if (!xioRegisterWrite(xio, 0x08, i2cBuf, xio->committedOutputs, XIO_OUTPUTS_COMMITTED))
+				return false;
+			xioPhase = XIO_PHASE_WRITE;
+			return true;
+	}
+	return false;
+}
+
+static void xioInputUpdate(XIOControl* xio, const uint8_t* inputRegs)
+{
+	uint8_t raw[5];
+	uint8_t i;
+	for(i=0; i<5; i++)
+		raw[i] = xio->direction[i] & inputRegs[i];
+	debounce(&xio->debounce, raw);
+
+	for(i=0; i<5; i++)
+	{
+		// Clear all things marked as inputs, leave outputs alone
+		xio->io[i] &= ~xio->direction[i];
+		// Only set anything that's high and marked as an input
+		xio->io[i] |= (xio->direction[i] & inputRegs[i]);
+	}
+}
+
+bool xioQueueInputRead(XIOControl* xio)
+{
+	return xioQueueTransaction(xio, XIO_OP_READ_INPUTS);
+}
+
+// Direction and interrupt mask go together or not at all
+bool xioQueueDirectionSend(XIOControl* xio)
+{
+	uint8_t needed = (xioTransactionQueued(xio, XIO_OP_WRITE_DIRECTION) ? 0 : 1)
+		+ (xioTransactionQueued(xio, XIO_OP_WRITE_IRQ_MASK) ? 0 : 1);
+
+	if (xioQueueCount + needed > XIO_QUEUE_DEPTH)
+		return false;
+	xioQueueTransaction(xio, XIO_OP_WRITE_DIRECTION);
+	xioQueueTransaction(xio, XIO_OP_WRITE_IRQ_MASK);
+	return true;
+}
+
+// True if the XIO already has exactly these registers, so a write can be skipped
+static bool xioRegistersCommitted(XIOControl* xio, const uint8_t* regs, const uint8_t* committed, uint8_t committedFlag)
+{
+	return (xio->status & committedFlag) && 0 == memcmp(regs, committed, 5);
+}
+
+bool xioQueueOutputWrite(XIOControl* xio)
+{
+	uint8_t regs[5];
+	uint8_t i;
+
+	// Reinforce direction ahead of every output write, if it's been lost
+	for(i=0; i<5; i++)
+		regs[i] = ~xio->direction[i];
+	if (!xioRegistersCommitted(xio, xio->direction, xio->committedDirection, XIO_DIRECTION_COMMITTED)
+		|| !xioRegistersCommitted(xio, regs, xio->committedIrqMask, XIO_IRQ_MASK_COMMITTED))
+	{
+		if (!xioQueueDirectionSend(xio))
+			return false;
+	}
+
+	for(i=0; i<5; i++)
+		regs[i] = xio->io[i] & ~xio->direction[i];
+	if (xioRegistersCommitted(xio, regs, xio->committedOutputs, XIO_OUTPUTS_COMMITTED))
+		return true;
+	return xioQueueTransaction(xio, XIO_OP_WRITE_OUTPUTS);
+}
+
+// Forget what was last committed so the next output write resends all of
+//  the direction and output registers, in case the XIO lost them somehow
+void xioForceRefresh(XIOControl* xio)
+{
+	xio->status &= ~(XIO_OUTPUTS_COMMITTED | XIO_DIRECTION_COMMITTED | XIO_IRQ_MASK_COMMITTED);
+}
+
+bool xioHasInputs(XIOControl* xio)
+{
+	uint8_t i;
 	for(i=0; i<5; i++)
-		i2cBuf[2+i] = xio->direction[i];
-	i2c_transmit(i2cBuf, 7, 1);
-	while(i2c_busy());
+	{
+		if (xio->direction[i])
+			return true;
+	}
+	return false;
+}
+
+// True while any input has moved away from its debounced state and is still
+//  being counted - it needs regular samples until it settles one way or the other
+bool xioDebounceInProgress(XIOControl* xio)
+{
+	uint8_t k;
+	for(k=0; k<XIO_DEBOUNCE_MAX_WIDTH; k++)
+	{
+		if (xio->debounce.clock[k] | xio->debounce.clockE[k])
+			return true;
+	}
+	return false;
+}
+
+bool xioBusy(void)
+{
+	return (XIO_PHASE_IDLE != xioPhase || 0 != xioQueueCount);
+}
+
+uint8_t xioProcess(void)
+{
+	uint8_t i2cBuf[8];
+	uint8_t completed = 0;
+
+	while(!i2c_busy())
+	{
+		XIOControl* xio = xioCurrent.xio;
+
+		switch(xioPhase)
+		{
+			case XIO_PHASE_READ_POINTER:
+				if (!i2c_transaction_successful())
+				{
+					xio->status |= XIO_I2C_ERROR;
+					xioPhase = XIO_PHASE_IDLE;
+					break;
+				}
+				i2cBuf[0] = xio->address | 0x01;
+				i2c_transmit(i2cBuf, 6, 1);
+				xioPhase = XIO_PHASE_READ_DATA;
+				continue;
+
+			case XIO_PHASE_READ_DATA:
+				if (i2c_receive(i2cBuf, 6))
+				{
+					xioInputUpdate(xio, &i2cBuf[1]);
+					completed |= XIO_COMPLETE_INPUTS_READ;
+				}
+				else
+				{
+					// In the event of a read hose-out, don't put crap in the input buffer
+					xio->status |= XIO_I2C_ERROR;
+				}
+				xioPhase = XIO_PHASE_IDLE;
+				break;
+
+			case XIO_PHASE_WRITE:
+				if (!i2c_transaction_successful())
+				{
+					// Don't trust the committed copy any more - the next write sends everything
+					xio->status |= XIO_I2C_ERROR;
+					switch(xioCurrent.op)
+					{
+						case XIO_OP_WRITE_OUTPUTS:
+							xio->status &= ~(XIO_OUTPUTS_COMMITTED);
+							break;
+						case XIO_OP_WRITE_DIRECTION:
+							xio->status &= ~(XIO_DIRECTION_COMMITTED);
+							break;
+						case XIO_OP_WRITE_IRQ_MASK:
+							xio->status &= ~(XIO_IRQ_MASK_COMMITTED);
+							break;
+					}
+				}
+				else if (XIO_OP_WRITE_OUTPUTS == xioCurrent.op)
+					completed |= XIO_COMPLETE_OUTPUTS_WRITTEN;
+				xioPhase = XIO_PHASE_IDLE;
+				break;
+		}
+
+		if (0 == xioQueueCount)
+			break;
+
+		xioCurrent = xioQueue[xioQueueHead];
+		xioQueueHead = (xioQueueHead + 1) % XIO_QUEUE_DEPTH;
+		xioQueueCount--;
+		// Nothing changed means nothing to send - just move on to the next one
+		xioStartTransaction();
+	}
+
+	return completed;
+}
+
+// Blocking versions - queue the transaction and pump the engine until
+//  everything ahead of it and the transaction itself are done.  Only for
+//  initialization and one-off use, the main loop should use the queue calls.
+void xioFlush(void)
+{
+	while(xioBusy())
+		xioProcess();
+}
+
+void xioDirectionSend(XIOControl* xio)
+{
+	xioQueueDirectionSend(xio);
+	xioFlush();
 }
 
 // xioPinDirections is an array of 5 bytes corresponding to IO0_0 (byte 0, bit 0) through IO4_7 (byte 4, bit 7)
@@ -97,45 +491,25 @@ void xioInitialize(XIOControl* xio, uint8_t xioAddress, const uint8_t* xioPinDir
 	memset(xio, 0, sizeof(XIOControl));
 		
 	xio->address = xioAddress;
-	xio->status |= XIO_I2C_ERROR;
 
 	for(i=0; i<5; i++)
 	{
 		xio->direction[i] = xioPinDirections[i];
-		initDebounceState(&xio->debounced_in[i], 0);
+		xioSetDebounceWidth(xio, i, XIO_DEBOUNCE_DEFAULT_WIDTH);
 	}
+	// Debounced state starts over, so whoever's watching has to look at everything
+	xio->debounce.changed = 0xFFFFFFFF;
+	xio->debounce.changedE = 0xFF;
 	xioDirectionSend(xio);
 
-	if (i2c_transaction_successful())
-	{
-		xio->status &= ~(XIO_I2C_ERROR);
+	if (0 == (xio->status & XIO_I2C_ERROR))
 		xio->status |= XIO_INITIALIZED;
-	}
-	
-	
 }
 
 void xioOutputWrite(XIOControl* xio)
 {
-	uint8_t i2cBuf[8];
-	uint8_t i;
-
-	// Reinforce direction
-	xioDirectionSend(xio);
-
-	while(i2c_busy());
-
-	if (!i2c_transaction_successful())
-		xio->status |= XIO_I2C_ERROR;
-
-	i2cBuf[0] = xio->address;
-	i2cBuf[1] = 0x80 | 0x08;  // 0x80 is auto-increment, 0x08 is the base of the output registers
-	for(i=0; i<5; i++)
-	{
-		i2cBuf[2+i] = xio->io[i] & ~xio->direction[i];
-	}
-
-	i2c_transmit(i2cBuf, 7, 1);
+	xioQueueOutputWrite(xio);
+	xioFlush();
 }
 
 void xioSetDeferredIO(XIOControl* xio, uint8_t ioNum, bool state)
@@ -165,6 +539,21 @@ void xioSetDeferredIObyPortBit(XIOControl* xio, uint8_t port, uint8_t bit, bool
 	xioSetDeferredIO(xio, ioNum, state);
 }
 
+// Set the output pins in mask to the matching bits of values
+void xioSetDeferredPort(XIOControl* xio, uint8_t port, uint8_t mask, uint8_t values)
+{
+	mask &= ~xio->direction[port];
+	xio->io[port] = (xio->io[port] & ~mask) | (values & mask);
+}
+
+// ...and the same for all five ports at once
+void xioSetDeferredOutputs(XIOControl* xio, const uint8_t* mask, const uint8_t* values)
+{
+	uint8_t i;
+	for(i=0; i<5; i++)
+		xioSetDeferredPort(xio, i, mask[i], values[i]);
+}
+
 bool xioGetDeferredIO(XIOControl* xio, uint8_t ioNum)
 {
 	if (ioNum >= 40)
@@ -178,7 +567,31 @@ bool xioGetDebouncedIO(XIOControl* xio, uint8_t ioNum)
 	if (ioNum >= 40)
 		return(0);
 	
-	return ((xio->debounced_in[ioNum/8].debounced_state & (1<<(ioNum % 8)))?true:false);
+	if (ioNum >= 32)
+		return ((xio->debounce.stateE & (1<<(ioNum - 32)))?true:false);
+	return ((xio->debounce.state & ((uint32_t)1<<ioNum))?true:false);
+}
+
+uint8_t xioGetDebouncedPort(XIOControl* xio, uint8_t port)
+{
+	if (XIO_PORT_E == port)
+		return xio->debounce.stateE;
+	return (uint8_t)(xio->debounce.state >> (8 * port));
+}
+
+// Hands back which debounced bits changed since the last call, one byte per
+//  port, and starts collecting again.  Returns false if nothing changed.
+bool xioDebouncedChangesTake(XIOControl* xio, uint8_t* changed)
+{
+	uint32_t changedWord = xio->debounce.changed;
+	changed[XIO_PORT_A] = (uint8_t)changedWord;
+	changed[XIO_PORT_B] = (uint8_t)(changedWord >> 8);
+	changed[XIO_PORT_C] = (uint8_t)(changedWord >> 16);
+	changed[XIO_PORT_D] = (uint8_t)(changedWord >> 24);
+	changed[XIO_PORT_E] = xio->debounce.changedE;
+	xio->debounce.changed = 0;
+	xio->debounce.changedE = 0;
+	return (0 != changedWord || 0 != changed[XIO_PORT_E]);
 }
 
 bool xioGetDebouncedIObyPortBit(XIOControl* xio, uint8_t port, uint8_t bit)
@@ -196,39 +609,6 @@ bool xioGetIO(XIOControl* xio, uint8_t ioNum)
 
 void xioInputRead(XIOControl *xio)
 {
-	uint8_t i2cBuf[8];
-	uint8_t successful = 0;
-
-	while(i2c_busy());
-
-	if (!i2c_transaction_successful())
-		xio->status |= XIO_I2C_ERROR;
-
-	i2cBuf[0] = xio->address;
-	i2cBuf[1] = 0x80;  // 0x80 is auto-increment, 0x00 is base of the input registers
-	i2c_transmit(i2cBuf, 2, 0);
-	i2cBuf[0] = xio->address | 0x01;
-	i2c_transmit(i2cBuf, 6, 1);
-	while(i2c_busy());
-	
-	successful = i2c_receive(i2cBuf, 6);
-
-	if (!successful)
-		// In the event of a read hose-out, don't put crap in the input buffer
-		xio->status |= XIO_I2C_ERROR;
-	else
-	{
-		uint8_t i;
-		for(i=0; i<5; i++)
-		{
-			debounce(&xio->debounced_in[i], (xio->direction[i] & i2cBuf[1+i]));
-			// Clear all things marked as inputs, leave outputs alone
-			xio->io[i] &= ~xio->direction[i];
-			// Only set anything that's high and marked as an input
-			xio->io[i] |= (xio->direction[i] & i2cBuf[1+i]);
-		}
-	}
+	xioQueueInputRead(xio);
+	xioFlush();
 }
-
-
-
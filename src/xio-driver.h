@@ -39,8 +39,14 @@ LICENSE:
 #define I2C_XIO6_ADDRESS 0x42
 #define I2C_XIO7_ADDRESS 0x40
 
+#define XIO_MAX_DEVICES  8
+#define I2C_XIO_ADDRESS(n)  (I2C_XIO0_ADDRESS - 2*(n))
+
 #define XIO_I2C_ERROR   0x01
 #define XIO_INITIALIZED 0x02
+#define XIO_OUTPUTS_COMMITTED    0x04
+#define XIO_DIRECTION_COMMITTED  0x08
+#define XIO_IRQ_MASK_COMMITTED   0x10
 
 #define XIO_PORT_A  0
 #define XIO_PORT_B  1
@@ -48,11 +54,42 @@ LICENSE:
 #define XIO_PORT_D  3
 #define XIO_PORT_E  4
 
+// Inputs are debounced with a vertical counter across all 40 pins at once -
+//  ports A-D packed into one 32 bit word (port A in the low byte), port E in
+//  its own byte.  Each port gets its own counter width, from 0 (no filtering)
+//  up to XIO_DEBOUNCE_MAX_WIDTH bits, and a change has to hold for 2^width
+//  samples in a row before it's accepted.  The default of 2 bits is 4 samples.
+//  Individual pins can also take a different width going high (assert) than
+//  going low (release), from a table in flash.
+#define XIO_DEBOUNCE_MAX_WIDTH      4
+#define XIO_DEBOUNCE_DEFAULT_WIDTH  2
+
+// Pins with their own widths on one XIO, fixed at compile time and kept in
+//  flash - see xioSetDebouncePinWidths().  assertPins/releasePins mark the pins
+//  that don't use their port's width in that direction, and the enables which
+//  of those count with each counter bit.  Packed the same way as the state.
+typedef struct
+{
+	uint32_t assertPins;
+	uint32_t releasePins;
+	uint32_t assertEnable[XIO_DEBOUNCE_MAX_WIDTH];   // Counter bits used going high
+	uint32_t releaseEnable[XIO_DEBOUNCE_MAX_WIDTH];  // ...and going low
+	uint8_t assertPinsE;
+	uint8_t releasePinsE;
+	uint8_t assertEnableE[XIO_DEBOUNCE_MAX_WIDTH];
+	uint8_t releaseEnableE[XIO_DEBOUNCE_MAX_WIDTH];
+} XIODebouncePinWidths;
+
 typedef struct
 {
-	uint8_t clock_A;
-	uint8_t clock_B;
-	uint8_t debounced_state;
+	uint32_t state;
+	uint32_t clock[XIO_DEBOUNCE_MAX_WIDTH];
+	uint8_t stateE;
+	uint8_t clockE[XIO_DEBOUNCE_MAX_WIDTH];
+	uint32_t changed;  // Debounced bits that changed since xioDebouncedChangesTake() last looked
+	uint8_t changedE;
+	uint8_t portWidth[5];  // Last width xioSetDebounceWidth() gave each port
+	const XIODebouncePinWidths* pinWidths;  // In flash, NULL if every pin goes by its port
 } XIODebounceState;
 
 typedef struct
@@ -60,13 +97,30 @@ typedef struct
 	uint8_t address;
 	uint8_t direction[5];
 	uint8_t io[5];
-	XIODebounceState debounced_in[5];
+	uint8_t committedOutputs[5];   // What the XIO's output registers were last sent
+	uint8_t committedDirection[5]; // What the XIO's direction registers were last sent
+	uint8_t committedIrqMask[5];   // What the XIO's interrupt mask registers were last sent
+	XIODebounceState debounce;
 	uint8_t status;
 } XIOControl;
 
+// RAM budget per XIO.  On the AVR an XIOControl is 64 bytes, so a full
+//  XIO_MAX_DEVICES set is 512 bytes - a quarter of the ATmega328P's 2K.
+//  Anything that grows the struct has to come out of that, or out of
+//  somewhere else.  Not checked on the host, where pointers and padding
+//  make it bigger.
+#define XIO_RAM_BUDGET  64
+#ifdef __AVR__
+typedef char XIOControlRamBudget_t[(sizeof(XIOControl) <= XIO_RAM_BUDGET) ? 1 : -1];
+#endif
+
 #define xioIsInitialized(xio)  ((xio)->status & XIO_INITIALIZED)
 #define xioI2CError(xio)  (((xio)->status & XIO_I2C_ERROR)?0:1)
 
+// Completion flags returned by xioProcess()
+#define XIO_COMPLETE_INPUTS_READ      0x01
+#define XIO_COMPLETE_OUTPUTS_WRITTEN  0x02
+
 #define XIO_LOW  false
 #define XIO_HIGH true
 
@@ -76,14 +130,30 @@ bool xioGetIO(XIOControl* xio, uint8_t ioNum);
 bool xioGetDeferredIO(XIOControl* xio, uint8_t ioNum);
 bool xioGetDebouncedIO(XIOControl* xio, uint8_t ioNum);
 bool xioGetDebouncedIObyPortBit(XIOControl* xio, uint8_t port, uint8_t bit);
+uint8_t xioGetDebouncedPort(XIOControl* xio, uint8_t port);
+bool xioDebouncedChangesTake(XIOControl* xio, uint8_t* changed);
 
 void xioSetIO(XIOControl* xio, uint8_t ioNum, bool state);
 void xioSetDeferredIO(XIOControl* xio, uint8_t ioNum, bool state);
 void xioSetDeferredIObyPortBit(XIOControl* xio, uint8_t port, uint8_t bit, bool state);
+void xioSetDeferredOutputs(XIOControl* xio, const uint8_t* mask, const uint8_t* values);
+void xioSetDeferredPort(XIOControl* xio, uint8_t port, uint8_t mask, uint8_t values);
 void xioOutputWrite(XIOControl* xio);
 void xioInitialize(XIOControl* xio, uint8_t xioAddress, const uint8_t* xioPinDirections);
 void xioDirectionSend(XIOControl* xio);
+void xioForceRefresh(XIOControl* xio);
+void xioSetDebounceWidth(XIOControl* xio, uint8_t port, uint8_t width);
+void xioSetDebouncePinWidths(XIOControl* xio, const XIODebouncePinWidths* pinWidths);
 void xioHardwareReset();
 
+bool xioQueueInputRead(XIOControl* xio);
+bool xioQueueOutputWrite(XIOControl* xio);
+bool xioQueueDirectionSend(XIOControl* xio);
+uint8_t xioProcess(void);
+bool xioBusy(void);
+bool xioHasInputs(XIOControl* xio);
+bool xioDebounceInProgress(XIOControl* xio);
+void xioFlush(void);
+
 #endif
 